@@ -0,0 +1,129 @@
+//========================================================//
+//  alias.c                                               //
+//  Source file for aliasing instrumentation              //
+//                                                        //
+//  Every access compares the accessing (pc, history)     //
+//  with the entry's last owner. Destructive collisions   //
+//  are also counted per entry so that the report can     //
+//  show whether interference is spread over the table    //
+//  or concentrated in a few hot entries                  //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include "alias.h"
+
+#define HIST_BUCKETS 18   // 0, 1, 2-3, 4-7, ..., >= 2^16
+
+typedef struct {
+  uint32_t pc;
+  uint32_t hist;
+  uint32_t destructive;
+  uint32_t valid;
+} alias_entry_t;
+
+typedef struct {
+  alias_entry_t *entries;
+  uint32_t size;
+  uint64_t accesses;
+  uint64_t constructive;
+  uint64_t destructive;
+} alias_table_t;
+
+static const char *tableName[ALIAS_TABLES] = { "Gshare PHT", "Global PHT",
+                                               "Local PHT", "Choice PHT" };
+
+static alias_table_t tables[ALIAS_TABLES];
+
+int aliasTrack;
+
+void
+alias_init(int table, uint32_t entries)
+{
+  alias_table_t *t = &tables[table];
+  free(t->entries);
+  t->entries = calloc(entries, sizeof(alias_entry_t));
+  if (t->entries == NULL) {
+    fprintf(stderr,"Out of memory for alias tracking\n");
+    exit(1);
+  }
+  t->size = entries;
+  t->accesses = t->constructive = t->destructive = 0;
+}
+
+void
+alias_access(int table, uint32_t index, uint32_t pc, uint32_t hist,
+             int correct)
+{
+  alias_table_t *t = &tables[table];
+  alias_entry_t *e = &t->entries[index];
+
+  t->accesses++;
+  if (e->valid && (e->pc != pc || e->hist != hist)) {
+    if (correct) {
+      t->constructive++;
+    } else {
+      t->destructive++;
+      e->destructive++;
+    }
+  }
+  e->pc = pc;
+  e->hist = hist;
+  e->valid = 1;
+}
+
+static int
+bucket_of(uint32_t n)
+{
+  int b = 0;
+  while (n != 0 && b < HIST_BUCKETS - 1) {
+    n >>= 1;
+    b++;
+  }
+  return b;
+}
+
+void
+alias_report()
+{
+  for (int i = 0; i < ALIAS_TABLES; i++) {
+    alias_table_t *t = &tables[i];
+    if (t->entries == NULL) {
+      continue;
+    }
+
+    uint32_t used = 0;
+    uint32_t hist[HIST_BUCKETS] = { 0 };
+    for (uint32_t j = 0; j < t->size; j++) {
+      used += t->entries[j].valid;
+      hist[bucket_of(t->entries[j].destructive)]++;
+    }
+
+    double n = t->accesses ? (double)t->accesses : 1;
+    printf("%s (%u entries, %u used)\n", tableName[i], t->size, used);
+    printf("  Accesses:        %10llu\n", (unsigned long long)t->accesses);
+    printf("  Constructive:    %10llu  (%7.3f%%)\n",
+           (unsigned long long)t->constructive, 100 * t->constructive / n);
+    printf("  Destructive:     %10llu  (%7.3f%%)\n",
+           (unsigned long long)t->destructive, 100 * t->destructive / n);
+    printf("  Destructive collisions per entry:\n");
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+      if (hist[b] == 0) {
+        continue;
+      }
+      char label[32];
+      uint32_t lo = b ? 1u << (b - 1) : 0;
+      uint32_t hi = b ? (1u << b) - 1 : 0;
+      if (b == HIST_BUCKETS - 1) {
+        snprintf(label, sizeof(label), "%u+", lo);
+      } else if (lo == hi) {
+        snprintf(label, sizeof(label), "%u", lo);
+      } else {
+        snprintf(label, sizeof(label), "%u-%u", lo, hi);
+      }
+      printf("    %-13s  %10u\n", label, hist[b]);
+    }
+
+    free(t->entries);
+    t->entries = NULL;
+  }
+}
@@ -0,0 +1,41 @@
+//========================================================//
+//  alias.h                                               //
+//  Header file for aliasing instrumentation              //
+//                                                        //
+//  Tags predictor table entries with their last owner    //
+//  and counts constructive and destructive collisions    //
+//========================================================//
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdint.h>
+
+// Instrumented tables
+#define ALIAS_GSHARE  0
+#define ALIAS_GLOBAL  1
+#define ALIAS_LOCAL   2
+#define ALIAS_CHOICE  3
+#define ALIAS_TABLES  4
+
+extern int aliasTrack;   // Non-zero to instrument predictor tables
+
+// Start tracking 'table', which has 'entries' entries
+//
+void alias_init(int table, uint32_t entries);
+
+// Record an access to entry 'index' of 'table' by the branch at 'pc'
+// with history 'hist'.  'correct' tells whether the entry, as found,
+// pointed the right way for this branch.  An access by a different
+// (pc, history) than the last one to touch the entry is a collision:
+// constructive if the entry was right anyway, destructive if not
+//
+void alias_access(int table, uint32_t index, uint32_t pc, uint32_t hist,
+                  int correct);
+
+// Print collision totals and the per-entry destructive collision
+// histogram of every tracked table
+//
+void alias_report();
+
+#endif
@@ -0,0 +1,197 @@
+//========================================================//
+//  alloc.c                                               //
+//  Source file for predictor table allocation            //
+//                                                        //
+//  Every table carries a header just before it telling   //
+//  how it was allocated, so one free works for both      //
+//  heap and mapped tables.  Large tables are mapped, so  //
+//  the kernel hands out zero pages on first touch and    //
+//  allocating them costs nothing up front                //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "alloc.h"
+
+#define HEADER 64   // Keeps the table itself cache line aligned
+
+typedef struct {
+  void *base;       // Start of the heap block or mapping
+  size_t length;    // Length of the mapping (0 for heap blocks)
+  size_t bytes;     // Size asked for
+  int huge;         // Mapping advised or reserved for huge pages
+} table_header_t;
+
+int hugePages = 0;
+static size_t hugeLive;
+static size_t tableLive;
+static size_t fillTotal;
+
+//------------------------------------//
+//         Allocator Functions        //
+//------------------------------------//
+
+// Map 'length' bytes (a multiple of HUGE_PAGE) of huge pages, trying
+// reserved pages before transparent ones
+//
+static void *
+map_huge(size_t length, size_t *mapped)
+{
+#ifdef MAP_HUGETLB
+  void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    *mapped = length;
+    return p;
+  }
+#endif
+
+  // Over-map by a page so the table can start on a 2 MB boundary,
+  // then give back the ends
+  size_t over = length + HUGE_PAGE;
+  char *raw = mmap(NULL, over, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return NULL;
+  }
+  char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE - 1) &
+                           ~(uintptr_t)(HUGE_PAGE - 1));
+  if (aligned > raw) {
+    munmap(raw, aligned - raw);
+  }
+  if (aligned + length < raw + over) {
+    munmap(aligned + length, raw + over - (aligned + length));
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+  *mapped = length;
+  return aligned;
+}
+
+void *
+table_alloc(size_t bytes)
+{
+  size_t total = bytes + HEADER;
+  table_header_t hdr = { NULL, 0, bytes, 0 };
+  char *block = NULL;
+
+  if (hugePages && bytes >= HUGE_MIN) {
+    // The header takes the first line of the first page
+    size_t length = (total + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    block = map_huge(length, &hdr.length);
+    if (block != NULL) {
+      hdr.huge = 1;
+      hugeLive += bytes;
+    }
+  }
+  if (block == NULL && bytes >= LAZY_MIN) {
+    // Anonymous pages read as zero, so nothing needs clearing
+    size_t length = (total + 4095) & ~(size_t)4095;
+    void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+      block = p;
+      hdr.length = length;
+    }
+  }
+  if (block == NULL) {
+    void *p;
+    if (posix_memalign(&p, HEADER, total) != 0) {
+      fprintf(stderr,"Out of memory for a %zu byte table\n", bytes);
+      exit(1);
+    }
+    memset(p, 0, total);
+    block = p;
+    hdr.length = 0;
+  }
+
+  hdr.base = block;
+  memcpy(block, &hdr, sizeof(hdr));
+  tableLive += bytes;
+  return block + HEADER;
+}
+
+void
+table_free(void *table)
+{
+  if (table == NULL) {
+    return;
+  }
+  table_header_t hdr;
+  memcpy(&hdr, (char *)table - HEADER, sizeof(hdr));
+  tableLive -= hdr.bytes;
+  if (hdr.huge) {
+    hugeLive -= hdr.bytes;
+  }
+  if (hdr.length > 0) {
+    munmap(hdr.base, hdr.length);
+  } else {
+    free(hdr.base);
+  }
+}
+
+void
+table_fill32(uint32_t *table, size_t n, uint32_t value)
+{
+  // Fresh tables are already zero; leave their pages untouched
+  if (value == 0) {
+    return;
+  }
+  fillTotal += n * sizeof(uint32_t);
+
+#ifdef MADV_POPULATE_WRITE
+  // Every page is about to be written: fault them all in with one
+  // call rather than one trap per page
+  size_t bytes = n * sizeof(uint32_t);
+  if (bytes >= LAZY_MIN) {
+    uintptr_t first = ((uintptr_t)table + 4095) & ~(uintptr_t)4095;
+    uintptr_t last = ((uintptr_t)table + bytes) & ~(uintptr_t)4095;
+    if (last > first) {
+      madvise((void *)first, last - first, MADV_POPULATE_WRITE);
+    }
+  }
+#endif
+
+  size_t i = 0;
+#ifdef __SSE2__
+  // table_alloc aligns tables to a cache line, so whole lines can be
+  // written with aligned 16-byte stores
+  __m128i v = _mm_set1_epi32((int)value);
+  for (; i + 16 <= n; i += 16) {
+    __m128i *line = (__m128i *)(table + i);
+    _mm_store_si128(line, v);
+    _mm_store_si128(line + 1, v);
+    _mm_store_si128(line + 2, v);
+    _mm_store_si128(line + 3, v);
+  }
+#endif
+  for (; i < n; i++) {
+    table[i] = value;
+  }
+}
+
+size_t
+huge_bytes()
+{
+  return hugeLive;
+}
+
+size_t
+table_bytes()
+{
+  return tableLive;
+}
+
+size_t
+filled_bytes()
+{
+  return fillTotal;
+}
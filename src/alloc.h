@@ -0,0 +1,58 @@
+//========================================================//
+//  alloc.h                                               //
+//  Header file for predictor table allocation            //
+//                                                        //
+//  Large tables can be backed by 2 MB pages so random    //
+//  indexing does not miss in the TLB on every access     //
+//========================================================//
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Back tables of at least HUGE_MIN bytes with huge pages (--hugepages)
+//
+#define HUGE_PAGE  (2u << 20)
+#define HUGE_MIN   (HUGE_PAGE / 2)
+extern int hugePages;
+
+// Tables of at least LAZY_MIN bytes are mapped rather than cleared
+//
+#define LAZY_MIN   (64u << 10)
+
+// Allocate a zeroed, 64-byte aligned table of 'bytes' bytes.  With
+// hugePages set, large tables come from explicit huge pages if any
+// are reserved, otherwise from a 2 MB aligned mapping advised for
+// transparent huge pages
+//
+// Exits if out of memory
+//
+void *table_alloc(size_t bytes);
+
+// Set the 'n' entries of a table from table_alloc to 'value'.  A
+// value of 0 costs nothing, since the table is zeroed already
+//
+void table_fill32(uint32_t *table, size_t n, uint32_t value);
+
+// Free a table from table_alloc (NULL is ignored)
+//
+void table_free(void *table);
+
+// Bytes of live tables placed in explicit or transparent huge page
+// mappings.  Transparent ones are a request the kernel may not grant
+//
+size_t huge_bytes();
+
+// Bytes of live tables
+//
+size_t table_bytes();
+
+// Bytes written by table_fill32 so far.  Tables filled with a nonzero
+// value are touched in full at startup instead of being zero pages
+// faulted in on first use
+//
+size_t filled_bytes();
+
+#endif
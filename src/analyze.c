@@ -0,0 +1,275 @@
+//========================================================//
+//  analyze.c                                             //
+//  Source file for the trace predictability analyzer     //
+//                                                        //
+//  All state is fixed size, so traces of any length can  //
+//  be analyzed in a single streaming pass:               //
+//   - per-PC bias and local-history entropy come from a  //
+//     set-associative table of hot PCs; evicted entries  //
+//     are folded into the running totals                 //
+//   - global-history correlation is estimated from       //
+//     hashed (pc, history) outcome counts per depth      //
+//   - aliasing pressure is measured on owner tags of a   //
+//     table of the requested size                        //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "predictor.h"
+#include "analyze.h"
+
+//------------------------------------//
+//        Analyzer Configuration      //
+//------------------------------------//
+
+#define PC_SETS       2048       // Sets in the per-PC table
+#define PC_WAYS       4          // Ways per set
+#define LOCAL_BITS    4          // Local history used for local entropy
+#define CELL_BITS     18         // log2 of hashed cells per history depth
+#define DISTINCT_BITS 20         // log2 of bits in the distinct-PC bitmap
+#define MAX_TABLE_BITS 24
+
+// History depths whose conditional entropy is measured
+static const int depths[] = { 0, 1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 32 };
+#define NDEPTHS ((int)(sizeof(depths)/sizeof(depths[0])))
+
+// Per-PC statistics
+typedef struct {
+  uint32_t pc;
+  uint32_t total;                         // 0 marks an empty way
+  uint32_t taken;
+  uint32_t lhist;
+  uint32_t ctx[1<<LOCAL_BITS][2];         // outcome counts per local history
+} pc_entry_t;
+
+static pc_entry_t *pcTable;
+
+// Totals folded from evicted and final per-PC entries
+static uint64_t foldedMajority;   // sum of max(taken, not taken) per PC
+static double foldedLocalBits;    // sum of n * H(outcome | local history)
+static double foldedBiasBits;     // sum of n * H(outcome | pc)
+static uint64_t biasBucket[4];    // dynamic branches by per-PC bias
+static uint64_t evictions;
+
+// Hashed (pc, global history) outcome counts, one plane per depth
+static uint16_t (*cells)[1<<CELL_BITS][2];
+static uint64_t ghist;
+
+// Aliasing pressure
+static int tableBits;
+static uint32_t *gshareOwner;
+static uint32_t *bimodalOwner;
+static uint64_t gshareConflicts;
+static uint64_t bimodalConflicts;
+static uint8_t *distinct;
+
+static uint64_t branches;
+
+//------------------------------------//
+//         Analyzer Functions         //
+//------------------------------------//
+
+// Binary entropy of a 't' out of 'n' split, scaled by 'n'
+//
+static double
+weighted_entropy(double t, double n)
+{
+  if (t <= 0 || t >= n) {
+    return 0;
+  }
+  double p = t / n;
+  return -n * (p * log2(p) + (1 - p) * log2(1 - p));
+}
+
+static uint32_t
+mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (uint32_t)x;
+}
+
+// Fold the statistics of one PC entry into the running totals
+//
+static void
+fold_entry(pc_entry_t *e)
+{
+  if (e->total == 0) {
+    return;
+  }
+  uint32_t majority = e->taken > e->total - e->taken ?
+                      e->taken : e->total - e->taken;
+  double bias = (double)majority / e->total;
+
+  foldedMajority += majority;
+  foldedBiasBits += weighted_entropy(e->taken, e->total);
+  for (int i = 0; i < (1<<LOCAL_BITS); i++) {
+    uint32_t t = e->ctx[i][TAKEN];
+    foldedLocalBits += weighted_entropy(t, t + e->ctx[i][NOTTAKEN]);
+  }
+  biasBucket[bias >= 0.99 ? 0 : bias >= 0.90 ? 1 : bias >= 0.70 ? 2 : 3] +=
+    e->total;
+  memset(e, 0, sizeof(*e));
+}
+
+static pc_entry_t *
+lookup_pc(uint32_t pc)
+{
+  pc_entry_t *set = &pcTable[(mix(pc) % PC_SETS) * PC_WAYS];
+  pc_entry_t *victim = &set[0];
+  for (int w = 0; w < PC_WAYS; w++) {
+    if (set[w].total != 0 && set[w].pc == pc) {
+      return &set[w];
+    }
+    if (set[w].total < victim->total) {
+      victim = &set[w];
+    }
+  }
+  // Replace the least executed way, keeping its statistics
+  if (victim->total != 0) {
+    evictions++;
+  }
+  fold_entry(victim);
+  victim->pc = pc;
+  return victim;
+}
+
+void
+analyze_init(int bits)
+{
+  tableBits = bits < 1 ? 1 : bits > MAX_TABLE_BITS ? MAX_TABLE_BITS : bits;
+  pcTable = calloc(PC_SETS * PC_WAYS, sizeof(pc_entry_t));
+  cells = calloc(NDEPTHS, sizeof(*cells));
+  gshareOwner = calloc(1<<tableBits, sizeof(uint32_t));
+  bimodalOwner = calloc(1<<tableBits, sizeof(uint32_t));
+  distinct = calloc(1<<(DISTINCT_BITS-3), 1);
+  if (!pcTable || !cells || !gshareOwner || !bimodalOwner || !distinct) {
+    fprintf(stderr,"Out of memory for analysis\n");
+    exit(1);
+  }
+}
+
+void
+analyze_branch(uint32_t pc, uint8_t outcome)
+{
+  branches++;
+
+  // Per-PC bias and local history
+  pc_entry_t *e = lookup_pc(pc);
+  if (e->total == UINT32_MAX) {
+    fold_entry(e);
+    e->pc = pc;
+  }
+  e->total++;
+  e->taken += outcome;
+  e->ctx[e->lhist][outcome]++;
+  e->lhist = ((e->lhist << 1) | outcome) & ((1<<LOCAL_BITS) - 1);
+
+  // Outcome counts per (pc, global history) at each depth
+  for (int d = 0; d < NDEPTHS; d++) {
+    uint64_t h = depths[d] == 0 ? 0 :
+                 ghist & (~0ULL >> (64 - depths[d]));
+    uint32_t c = mix(((uint64_t)pc << 32) ^ h ^ ((uint64_t)d << 58)) &
+                 ((1<<CELL_BITS) - 1);
+    uint16_t *cell = cells[d][c];
+    if (cell[outcome] == UINT16_MAX) {
+      cell[0] >>= 1;
+      cell[1] >>= 1;
+    }
+    cell[outcome]++;
+  }
+
+  // Owner tags of a gshare-indexed and a PC-indexed table
+  uint32_t mask = (1u<<tableBits) - 1;
+  uint32_t gidx = (pc ^ (uint32_t)ghist) & mask;
+  uint32_t bidx = pc & mask;
+  gshareConflicts += gshareOwner[gidx] != 0 && gshareOwner[gidx] != pc + 1;
+  bimodalConflicts += bimodalOwner[bidx] != 0 && bimodalOwner[bidx] != pc + 1;
+  gshareOwner[gidx] = pc + 1;
+  bimodalOwner[bidx] = pc + 1;
+
+  uint32_t bit = mix(pc) & ((1<<DISTINCT_BITS) - 1);
+  distinct[bit >> 3] |= 1 << (bit & 7);
+
+  ghist = (ghist << 1) | outcome;
+}
+
+void
+analyze_report()
+{
+  for (int i = 0; i < PC_SETS * PC_WAYS; i++) {
+    fold_entry(&pcTable[i]);
+  }
+
+  // Linear counting estimate of distinct PCs
+  uint64_t zeros = 0;
+  for (int i = 0; i < (1<<(DISTINCT_BITS-3)); i++) {
+    zeros += 8 - __builtin_popcount(distinct[i]);
+  }
+  double m = 1 << DISTINCT_BITS;
+  double distinctPCs = zeros ? -m * log(zeros / m) : m;
+
+  double n = branches ? (double)branches : 1;
+  printf("Branches:            %12llu\n", (unsigned long long)branches);
+  printf("Distinct PCs (est):  %12.0f\n", distinctPCs);
+  printf("PC table evictions:  %12llu\n", (unsigned long long)evictions);
+
+  printf("\nPer-PC bias (share of dynamic branches)\n");
+  printf("  >= 99%%:   %7.3f\n", 100 * biasBucket[0] / n);
+  printf("  >= 90%%:   %7.3f\n", 100 * biasBucket[1] / n);
+  printf("  >= 70%%:   %7.3f\n", 100 * biasBucket[2] / n);
+  printf("  <  70%%:   %7.3f\n", 100 * biasBucket[3] / n);
+  printf("  Ideal per-PC static misprediction rate: %7.3f\n",
+         100 * (1 - foldedMajority / n));
+
+  printf("\nConditional entropy (bits/branch)\n");
+  printf("  H(outcome | pc)                 %7.4f\n", foldedBiasBits / n);
+  printf("  H(outcome | pc, %d local bits)   %7.4f\n", LOCAL_BITS,
+         foldedLocalBits / n);
+
+  double entropy[NDEPTHS];
+  for (int d = 0; d < NDEPTHS; d++) {
+    // Halved cells undercount, so normalize by the counts kept
+    double bits = 0, kept = 0;
+    for (int c = 0; c < (1<<CELL_BITS); c++) {
+      double total = cells[d][c][0] + cells[d][c][1];
+      bits += weighted_entropy(cells[d][c][1], total);
+      kept += total;
+    }
+    entropy[d] = kept ? bits / kept : 0;
+    printf("  H(outcome | pc, %2d global bits) %7.4f\n", depths[d],
+           entropy[d]);
+  }
+
+  // Correlation depth: shortest history that gets 90% of the
+  // entropy reduction achieved by the best depth
+  int best = 0;
+  for (int d = 1; d < NDEPTHS; d++) {
+    if (entropy[d] < entropy[best]) {
+      best = d;
+    }
+  }
+  int depth = best;
+  for (int d = 0; d <= best; d++) {
+    if (entropy[0] - entropy[d] >= 0.9 * (entropy[0] - entropy[best])) {
+      depth = d;
+      break;
+    }
+  }
+  printf("  Global correlation depth:       %7d\n", depths[depth]);
+
+  printf("\nAliasing pressure (%d-entry table)\n", 1<<tableBits);
+  printf("  Distinct PCs per entry:        %7.3f\n",
+         distinctPCs / (1<<tableBits));
+  printf("  PC-indexed conflict rate:      %7.3f\n",
+         100 * bimodalConflicts / n);
+  printf("  Gshare-indexed conflict rate:  %7.3f\n",
+         100 * gshareConflicts / n);
+
+  free(pcTable);
+  free(cells);
+  free(gshareOwner);
+  free(bimodalOwner);
+  free(distinct);
+}
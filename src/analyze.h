@@ -0,0 +1,27 @@
+//========================================================//
+//  analyze.h                                             //
+//  Header file for the trace predictability analyzer     //
+//                                                        //
+//  Measures how predictable a trace is before choosing   //
+//  a predictor, in one pass and bounded memory           //
+//========================================================//
+
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdint.h>
+
+// Prepare the analyzer.  'tableBits' sizes the hypothetical
+// 2-bit counter table used to measure aliasing pressure
+//
+void analyze_init(int tableBits);
+
+// Account for one branch of the trace
+//
+void analyze_branch(uint32_t pc, uint8_t outcome);
+
+// Print the predictability report on stdout and free all state
+//
+void analyze_report();
+
+#endif
@@ -0,0 +1,197 @@
+//========================================================//
+//  bpred.c                                               //
+//  Library interface to the branch predictors            //
+//                                                        //
+//  Every instance owns a predictor context.  The active  //
+//  one lives in the predictor globals and is only saved  //
+//  and replaced when a call names a different instance,  //
+//  so a single embedded predictor runs at full speed     //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bpred.h"
+#include "predictor.h"
+#include "alloc.h"
+#include "hash.h"
+
+// Perceptron sizes accepted by bp_create
+#define MAX_PERC_HISTORY 1024
+#define MAX_PERC_ROWS    (1<<24)
+
+struct bp_predictor {
+  predictor_context_t *ctx;
+  int hugePages;
+};
+
+// Instance whose state is in the globals
+static bp_predictor_t *active;
+
+//------------------------------------//
+//          Library Functions         //
+//------------------------------------//
+
+static inline void
+activate(bp_predictor_t *bp)
+{
+  if (bp == active) {
+    return;
+  }
+  if (active != NULL) {
+    context_save(active->ctx);
+  }
+  context_load(bp->ctx);
+  hugePages = bp->hugePages;
+  active = bp;
+}
+
+void
+bp_config_default(bp_config_t *config, int scheme)
+{
+  memset(config, 0, sizeof(*config));
+  config->size = sizeof(bp_config_t);
+  config->scheme = scheme;
+  config->indexHash = -1;
+  switch (scheme) {
+    case BP_GSHARE:
+    case BP_BIMODE:
+    case BP_GSKEW:
+      config->ghistoryBits = 13;
+      break;
+    case BP_TOURNAMENT:
+      config->ghistoryBits = 9;
+      config->lhistoryBits = 10;
+      config->pcIndexBits = 10;
+      break;
+    case BP_PERCEPTRON:
+      config->percHistory = 32;
+      config->percRows = 256;
+      config->percWeightBits = 8;
+      break;
+    default:
+      break;
+  }
+}
+
+bp_predictor_t *
+bp_create(const bp_config_t *config)
+{
+  const bp_config_t *c = config;
+  if (c == NULL || c->size != sizeof(bp_config_t) ||
+      c->scheme < BP_STATIC || c->scheme > BP_PERCEPTRON ||
+      c->ghistoryBits < 0 || c->ghistoryBits > 30 ||
+      c->lhistoryBits < 0 || c->lhistoryBits > 30 ||
+      c->pcIndexBits < 0 || c->pcIndexBits > 30 ||
+      c->globalEntries < 0 ||
+      c->indexHash < -1 || c->indexHash >= NHASHES ||
+      c->loopBits < 0 || c->loopBits > MAX_LOOP_BITS ||
+      c->jrsBits < -1 || c->jrsBits > MAX_JRS_BITS ||
+      c->updateDelay < 0 || c->updateDelay > MAX_DELAY ||
+      c->hugePages < 0 || c->hugePages > 1) {
+    return NULL;
+  }
+  // The perceptron fields are ignored by the other schemes
+  if (c->scheme == BP_PERCEPTRON &&
+      (c->percHistory < 1 || c->percHistory > MAX_PERC_HISTORY ||
+       c->percRows < 1 || c->percRows > MAX_PERC_ROWS ||
+       c->percWeightBits < 2 || c->percWeightBits > 32 ||
+       c->percTheta < 0)) {
+    return NULL;
+  }
+
+  bp_predictor_t *bp = malloc(sizeof(bp_predictor_t));
+  if (bp == NULL) {
+    return NULL;
+  }
+  bp->ctx = context_alloc();
+  bp->hugePages = c->hugePages;
+  if (bp->ctx == NULL) {
+    free(bp);
+    return NULL;
+  }
+
+  // Start from an empty context so init_predictor frees nothing that
+  // belongs to another instance
+  activate(bp);
+  ghistoryBits = c->ghistoryBits;
+  lhistoryBits = c->lhistoryBits;
+  pcIndexBits = c->pcIndexBits;
+  bpType = c->scheme;
+  indexHash = c->indexHash;
+  globalEntries = c->globalEntries;
+  loopBits = c->loopBits;
+  jrsBits = c->jrsBits;
+  updateDelay = c->updateDelay;
+  percHistory = c->percHistory;
+  percRows = c->percRows;
+  percWeightBits = c->percWeightBits;
+  percTheta = c->percTheta;
+  init_predictor();
+  return bp;
+}
+
+uint8_t
+bp_predict(bp_predictor_t *bp, uint32_t pc)
+{
+  activate(bp);
+  return make_prediction(pc);
+}
+
+uint8_t
+bp_confidence(bp_predictor_t *bp)
+{
+  activate(bp);
+  return prediction_confidence();
+}
+
+void
+bp_train(bp_predictor_t *bp, uint32_t pc, uint8_t outcome)
+{
+  activate(bp);
+  train_predictor(pc, outcome);
+}
+
+void
+bp_predict_batch(bp_predictor_t *bp, const uint32_t *pcs, int n,
+                 uint8_t *predictions)
+{
+  activate(bp);
+  predict_batch(pcs, n > BP_MAX_BATCH ? BP_MAX_BATCH : n, predictions);
+}
+
+void
+bp_train_batch(bp_predictor_t *bp, const uint32_t *pcs,
+               const uint8_t *outcomes, int n)
+{
+  activate(bp);
+  train_batch(pcs, outcomes, n > BP_MAX_BATCH ? BP_MAX_BATCH : n);
+}
+
+void
+bp_flush(bp_predictor_t *bp)
+{
+  activate(bp);
+  flush_predictor();
+}
+
+uint32_t
+bp_storage_bits(bp_predictor_t *bp)
+{
+  activate(bp);
+  return storage_bits();
+}
+
+void
+bp_free(bp_predictor_t *bp)
+{
+  if (bp == NULL) {
+    return;
+  }
+  activate(bp);
+  flush_predictor();
+  free_predictor();
+  free(bp->ctx);
+  free(bp);
+  active = NULL;
+}
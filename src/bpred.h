@@ -0,0 +1,122 @@
+//========================================================//
+//  bpred.h                                               //
+//  Library interface to the branch predictors            //
+//                                                        //
+//  Link with libbpred.a or libbpred.so to embed any of   //
+//  the predictors in another simulator.  Each predictor  //
+//  is a separate instance; calls are not thread safe     //
+//========================================================//
+
+#ifndef BPRED_H
+#define BPRED_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped whenever this interface changes incompatibly
+#define BP_API_VERSION 2
+
+// The library is built with hidden visibility; these are its exports
+#if defined(__GNUC__)
+#define BP_API __attribute__((visibility("default")))
+#else
+#define BP_API
+#endif
+
+// Prediction schemes
+#define BP_STATIC      0
+#define BP_GSHARE      1
+#define BP_TOURNAMENT  2
+#define BP_CUSTOM      3
+#define BP_BIMODE      4
+#define BP_GSKEW       5
+#define BP_PERCEPTRON  6
+
+// Confidence levels returned by bp_confidence
+#define BP_CONF_LOW    0
+#define BP_CONF_MED    1
+#define BP_CONF_HIGH   2
+
+// Largest block accepted by bp_predict_batch and bp_train_batch
+#define BP_MAX_BATCH   64
+
+// Predictor configuration, as set by the command line options of
+// the predictor program.  Start from bp_config_default, which sets
+// 'size' so that bp_create can tell a caller built against another
+// version of this structure
+//
+typedef struct {
+  uint32_t size;         // sizeof(bp_config_t)
+  int scheme;            // BP_* scheme
+  int ghistoryBits;      // Global history bits
+  int lhistoryBits;      // Local history bits (tournament, custom)
+  int pcIndexBits;       // Local history table index bits
+  int globalEntries;     // Global table entries (0 for 2^ghistoryBits)
+  int indexHash;         // Global index hash (-1 for scheme default)
+  int loopBits;          // log2 loop predictor entries (0 for none, <= 24)
+  int jrsBits;           // log2 JRS estimator entries (0 for none,
+                         // -1 for ghistoryBits, <= 24)
+  int updateDelay;       // Branches between prediction and training
+                         // (<= 4096)
+  int percHistory;       // Perceptron history length (1..1024)
+  int percRows;          // Number of perceptrons (1..2^24)
+  int percWeightBits;    // Bits per perceptron weight (2..32)
+  int percTheta;         // Perceptron threshold (0 for default)
+  int hugePages;         // Back large tables with 2 MB pages (0 or 1)
+} bp_config_t;
+
+typedef struct bp_predictor bp_predictor_t;
+
+// Fill 'config' with the defaults of 'scheme' (the sizes the
+// predictor program is usually run with)
+//
+BP_API void bp_config_default(bp_config_t *config, int scheme);
+
+// Create a predictor
+//
+// Returns NULL if any field of the configuration is out of range or
+// 'size' does not match this version of bp_config_t
+//
+BP_API bp_predictor_t *bp_create(const bp_config_t *config);
+
+// Predict the branch at 'pc' (1 taken, 0 not taken)
+//
+BP_API uint8_t bp_predict(bp_predictor_t *bp, uint32_t pc);
+
+// Confidence (BP_CONF_*) of the last prediction of 'bp'
+//
+BP_API uint8_t bp_confidence(bp_predictor_t *bp);
+
+// Train with the outcome of the branch at 'pc' last predicted
+//
+BP_API void bp_train(bp_predictor_t *bp, uint32_t pc, uint8_t outcome);
+
+// Predict a block of 'n' branches (at most BP_MAX_BATCH) with the
+// histories at block start, then train the block with its outcomes
+//
+BP_API void bp_predict_batch(bp_predictor_t *bp, const uint32_t *pcs,
+                             int n, uint8_t *predictions);
+BP_API void bp_train_batch(bp_predictor_t *bp, const uint32_t *pcs,
+                           const uint8_t *outcomes, int n);
+
+// Train the branches still waiting out updateDelay, e.g. before
+// reading results at the end of a run
+//
+BP_API void bp_flush(bp_predictor_t *bp);
+
+// Bits of state kept by the predictor
+//
+BP_API uint32_t bp_storage_bits(bp_predictor_t *bp);
+
+// Destroy a predictor (NULL is ignored)
+//
+BP_API void bp_free(bp_predictor_t *bp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+# Delaying training by one branch must barely change any scheme's
+# rate, as long as the speculative histories are repaired properly
+make predictor > /dev/null || exit 1
+trace=${1:-../traces/int_1.bz2}
+status=0
+for s in gshare:13 tournament:9:10:10 custom bimode:13 gskew:13 \
+         perceptron:32:256; do
+  r0=$(./predictor --$s $trace | sed -n 's/^Misprediction Rate: *//p')
+  r1=$(./predictor --$s --delay:1 $trace | sed -n 's/^Misprediction Rate: *//p')
+  case "$r0$r1" in
+    *[!0-9.]*|"")
+      echo "FAIL $s: no rate for $trace"
+      status=1
+      continue
+      ;;
+  esac
+  if awk "BEGIN { d = $r1 - $r0; exit !(d < -0.5 || d > 0.5) }"; then
+    echo "FAIL $s: $r0 without delay, $r1 with --delay:1"
+    status=1
+  else
+    echo "ok   $s: $r0 / $r1"
+  fi
+done
+exit $status
@@ -0,0 +1,230 @@
+//========================================================//
+//  gentrace.c                                            //
+//  Synthetic trace generator                             //
+//                                                        //
+//  Writes a deterministic trace in the format main.c     //
+//  reads ("0x<pc> <outcome>" per line) from a mix of     //
+//  biased, loop, correlated and random branches spread   //
+//  over any number of static branch sites                //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Kinds of branch site
+#define SITE_BIASED      0
+#define SITE_LOOP        1
+#define SITE_CORRELATED  2
+#define SITE_RANDOM      3
+#define NKINDS           4
+
+typedef struct {
+  uint32_t pc;
+  uint8_t kind;
+  uint8_t invert;      // Correlated: follow the leader inverted
+  uint16_t trip;       // Loop: iterations per execution of the loop
+  uint32_t takenProb;  // Biased: P(taken) scaled to 2^32
+} site_t;
+
+static uint64_t branches = 10000000;
+static uint32_t nsites = 1000000;
+static uint64_t seed = 1;
+static int mix[NKINDS] = { 50, 20, 20, 10 };
+static int tripMin = 2, tripMax = 64;
+static double bias = 0.95;
+static double locality = 0.9;
+
+static uint64_t rngState;
+
+//------------------------------------//
+//         Generator Functions        //
+//------------------------------------//
+
+// SplitMix64, so a seed fully determines the trace on every platform
+//
+static uint64_t
+next_random()
+{
+  uint64_t z = (rngState += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static uint32_t
+random_below(uint32_t n)
+{
+  return (uint32_t)(((next_random() >> 32) * n) >> 32);
+}
+
+// Give every site its kind and parameters, and a pc.  Sites are laid
+// out 4 bytes apart, with a random gap now and then like the ends of
+// functions
+//
+static site_t *
+make_sites()
+{
+  site_t *sites = malloc(sizeof(site_t) * nsites);
+  if (sites == NULL) {
+    fprintf(stderr,"Out of memory for %u sites\n", nsites);
+    exit(1);
+  }
+  int total = mix[0] + mix[1] + mix[2] + mix[3];
+  uint32_t pc = 0x00400000;
+  for (uint32_t i = 0; i < nsites; i++) {
+    site_t *s = &sites[i];
+    int r = random_below(total);
+    for (s->kind = 0; s->kind < NKINDS - 1 && r >= mix[s->kind]; s->kind++) {
+      r -= mix[s->kind];
+    }
+    // A correlated site needs a leader just before it
+    if (s->kind == SITE_CORRELATED && i == 0) {
+      s->kind = SITE_RANDOM;
+    }
+    s->invert = random_below(2);
+    s->trip = tripMin + random_below(tripMax - tripMin + 1);
+    s->takenProb = (uint32_t)((random_below(2) ? bias : 1 - bias) *
+                              4294967295.0);
+    pc += 4 + (random_below(16) == 0 ? 4 * random_below(64) : 0);
+    s->pc = pc;
+  }
+  return sites;
+}
+
+// Buffered writer for the "0x%08x %d\n" lines
+//
+static char outBuf[1 << 16];
+static size_t outLen;
+
+static void
+emit(uint32_t pc, int outcome)
+{
+  static const char hex[] = "0123456789abcdef";
+  if (outLen + 14 > sizeof(outBuf)) {
+    fwrite(outBuf, 1, outLen, stdout);
+    outLen = 0;
+  }
+  char *p = outBuf + outLen;
+  p[0] = '0';
+  p[1] = 'x';
+  for (int i = 0; i < 8; i++) {
+    p[2 + i] = hex[(pc >> (28 - 4 * i)) & 0xf];
+  }
+  p[10] = ' ';
+  p[11] = '0' + outcome;
+  p[12] = '\n';
+  outLen += 13;
+}
+
+void
+usage()
+{
+  fprintf(stderr,"Usage: gentrace <options> > trace\n");
+  fprintf(stderr," Options:\n");
+  fprintf(stderr," --branches=<n>   Records to write (default 10000000)\n");
+  fprintf(stderr," --sites=<n>      Static branches (default 1000000)\n");
+  fprintf(stderr," --seed=<n>       Random seed (default 1)\n");
+  fprintf(stderr," --mix=<b>:<l>:<c>:<r>  Weights of biased, loop,\n"
+                 "                  correlated and random sites\n"
+                 "                  (default 50:20:20:10)\n");
+  fprintf(stderr," --trip=<lo>:<hi> Loop trip count range (default 2:64)\n");
+  fprintf(stderr," --bias=<p>       Taken or not taken probability of\n"
+                 "                  biased sites (default 0.95)\n");
+  fprintf(stderr," --locality=<p>   Probability of falling through to the\n"
+                 "                  next site (default 0.9)\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i],"--branches=",11)) {
+      branches = strtoull(argv[i]+11, NULL, 10);
+    } else if (!strncmp(argv[i],"--sites=",8)) {
+      nsites = strtoul(argv[i]+8, NULL, 10);
+    } else if (!strncmp(argv[i],"--seed=",7)) {
+      seed = strtoull(argv[i]+7, NULL, 10);
+    } else if (!strncmp(argv[i],"--mix=",6)) {
+      if (sscanf(argv[i]+6, "%d:%d:%d:%d", &mix[0], &mix[1], &mix[2],
+                 &mix[3]) != 4) {
+        usage();
+        exit(1);
+      }
+    } else if (!strncmp(argv[i],"--trip=",7)) {
+      if (sscanf(argv[i]+7, "%d:%d", &tripMin, &tripMax) != 2) {
+        usage();
+        exit(1);
+      }
+    } else if (!strncmp(argv[i],"--bias=",7)) {
+      bias = atof(argv[i]+7);
+    } else if (!strncmp(argv[i],"--locality=",11)) {
+      locality = atof(argv[i]+11);
+    } else {
+      usage();
+      exit(strcmp(argv[i],"--help") != 0);
+    }
+  }
+  if (nsites == 0 || mix[0] + mix[1] + mix[2] + mix[3] <= 0 ||
+      mix[0] < 0 || mix[1] < 0 || mix[2] < 0 || mix[3] < 0 ||
+      tripMin < 1 || tripMax < tripMin || tripMax > 65535) {
+    usage();
+    exit(1);
+  }
+
+  rngState = seed;
+  site_t *sites = make_sites();
+  uint32_t stayProb = (uint32_t)(locality * 4294967295.0);
+  uint32_t cur = 0;
+  int lastOutcome = 0;
+  uint64_t n = 0;
+
+  // Walk the sites, mostly falling through to the next one
+  while (n < branches) {
+    site_t *s = &sites[cur];
+    switch (s->kind) {
+      case SITE_BIASED:
+        lastOutcome = (uint32_t)(next_random() >> 32) < s->takenProb;
+        emit(s->pc, lastOutcome);
+        n++;
+        break;
+      case SITE_LOOP:
+        // Taken back to the top until the last iteration
+        for (int k = 1; k <= s->trip && n < branches; k++, n++) {
+          emit(s->pc, k < s->trip);
+        }
+        lastOutcome = 0;
+        break;
+      case SITE_CORRELATED:
+        // Repeat the previous site's outcome, when it really ran last
+        if (cur == 0 || sites[cur-1].kind == SITE_LOOP) {
+          lastOutcome = random_below(2);
+        } else {
+          lastOutcome ^= s->invert;
+        }
+        emit(s->pc, lastOutcome);
+        n++;
+        break;
+      default:
+        lastOutcome = random_below(2);
+        emit(s->pc, lastOutcome);
+        n++;
+        break;
+    }
+
+    if ((uint32_t)(next_random() >> 32) < stayProb) {
+      cur = (cur + 1) % nsites;
+    } else {
+      // Jumping away breaks the correlation with the previous site
+      cur = random_below(nsites);
+      if (sites[cur].kind == SITE_CORRELATED && cur > 0) {
+        cur--;
+      }
+    }
+  }
+
+  fwrite(outBuf, 1, outLen, stdout);
+  free(sites);
+  return 0;
+}
@@ -0,0 +1,130 @@
+//========================================================//
+//  hash.h                                                //
+//  Index hash functions for predictor tables             //
+//                                                        //
+//  All hashes are inline so that the selected one is     //
+//  compiled straight into the predict/train paths        //
+//========================================================//
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+
+// The Different Index Hashes
+#define HASH_HIST    0   // history only (tournament default)
+#define HASH_XOR     1   // low pc bits ^ history (gshare default)
+#define HASH_FOLD    2   // all pc bits folded down, ^ history
+#define HASH_SELECT  3   // low pc bits concatenated with history bits
+#define HASH_SKEW    4   // gskew bank 0 skewing function
+#define HASH_CRC     5   // CRC-32C of pc and history
+#define NHASHES      6
+extern const char *hashName[];
+
+static inline uint32_t
+hash_mask(int bits)
+{
+  return bits >= 32 ? 0xffffffff : (1u << bits) - 1;
+}
+
+// Map a 'bits'-bit index 'x' onto [0, entries) with a multiply and a
+// shift.  With entries == 2^bits this is the identity
+//
+static inline uint32_t
+fast_range(uint32_t x, uint32_t entries, int bits)
+{
+  return (uint32_t)(((uint64_t)x * entries) >> bits);
+}
+
+// Seznec's skewing function H over 'bits'-bit vectors and its inverse
+//
+static inline uint32_t
+skew_h(uint32_t y, int bits)
+{
+  uint32_t top = (y ^ (y >> (bits - 1))) & 1;
+  return (y >> 1) | (top << (bits - 1));
+}
+
+static inline uint32_t
+skew_hinv(uint32_t y, int bits)
+{
+  uint32_t low = ((y >> (bits - 1)) ^ (y >> (bits - 2))) & 1;
+  return ((y << 1) & hash_mask(bits)) | low;
+}
+
+// Index for bank 0, 1 or 2 of a skewed-associative table
+//
+static inline uint32_t
+skew_index(int bank, uint32_t pc, uint32_t hist, int bits)
+{
+  uint32_t mask = hash_mask(bits);
+  uint32_t v1 = pc & mask;
+  uint32_t v2 = hist & mask;
+  if (bits < 2) {
+    return (v1 ^ v2) & mask;
+  }
+  switch (bank) {
+    case 0:
+      return skew_h(v1, bits) ^ skew_hinv(v2, bits) ^ v2;
+    case 1:
+      return skew_h(v1, bits) ^ skew_hinv(v2, bits) ^ v1;
+    default:
+      return skew_hinv(v1, bits) ^ skew_h(v2, bits) ^ v2;
+  }
+}
+
+// CRC-32C with a 16-entry table, one nibble per step
+//
+static inline uint32_t
+crc_lite(uint32_t crc, uint32_t data)
+{
+  static const uint32_t nibble[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1,
+    0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+    0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9,
+    0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75
+  };
+  for (int i = 0; i < 8; i++) {
+    crc ^= data & 0xf;
+    crc = (crc >> 4) ^ nibble[crc & 0xf];
+    data >>= 4;
+  }
+  return crc;
+}
+
+// Index into a table of 2^'bits' entries for the branch at 'pc'
+// with global history 'hist'
+//
+static inline uint32_t
+index_hash(int kind, uint32_t pc, uint32_t hist, int bits)
+{
+  uint32_t mask = hash_mask(bits);
+  uint32_t h = hist & mask;
+  uint32_t folded;
+  int pcBits;
+
+  switch (kind) {
+    case HASH_HIST:
+      return h;
+    case HASH_XOR:
+      return (pc ^ h) & mask;
+    case HASH_FOLD:
+      folded = 0;
+      for (int shift = 0; shift < 32 && bits > 0; shift += bits) {
+        folded ^= pc >> shift;
+      }
+      return (folded ^ h) & mask;
+    case HASH_SELECT:
+      pcBits = bits / 2;
+      return ((pc & hash_mask(pcBits)) << (bits - pcBits)) |
+             (h & hash_mask(bits - pcBits));
+    case HASH_SKEW:
+      return skew_index(0, pc, h, bits);
+    case HASH_CRC:
+      return crc_lite(crc_lite(0xffffffff, pc), h) & mask;
+    default:
+      return (pc ^ h) & mask;
+  }
+}
+
+#endif
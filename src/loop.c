@@ -0,0 +1,183 @@
+//========================================================//
+//  loop.c                                                //
+//  Source file for the loop predictor                    //
+//                                                        //
+//  Each entry records the direction a loop branch takes  //
+//  while iterating, the trip count seen the last time    //
+//  the loop exited and the current iteration. After the  //
+//  same trip count is seen CONF_MAX times in a row the   //
+//  entry predicts the exit                               //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "predictor.h"
+#include "loop.h"
+
+#define LOOP_WAYS  4
+#define TAG_BITS   14
+#define ITER_BITS  14
+#define CONF_BITS  2
+#define AGE_BITS   8
+#define CONF_MAX   ((1<<CONF_BITS) - 1)
+#define AGE_MAX    ((1<<AGE_BITS) - 1)
+#define ITER_MAX   ((1<<ITER_BITS) - 1)
+
+typedef struct {
+  uint16_t tag;
+  uint16_t past;       // Trip count at the last exit (0 if unknown)
+  uint16_t current;    // Iterations since the last exit
+  uint8_t conf;
+  uint8_t age;         // Replacement priority, 0 means free to replace
+  uint8_t dir;         // Direction taken while iterating
+  uint8_t valid;
+} loop_entry_t;
+
+static loop_entry_t *loopTable;
+static uint32_t setMask;
+static int setBits;
+
+//------------------------------------//
+//       Loop Predictor Functions     //
+//------------------------------------//
+
+void
+loop_init(int bits)
+{
+  if (bits < 2) {
+    bits = 2;
+  }
+  setBits = bits - 2;
+  setMask = (1<<setBits) - 1;
+  free(loopTable);
+  loopTable = calloc(1<<bits, sizeof(loop_entry_t));
+  if (!loopTable) {
+    fprintf(stderr,"Out of memory for a %d entry loop predictor\n", 1<<bits);
+    exit(1);
+  }
+}
+
+static uint16_t
+loop_tag(uint32_t pc)
+{
+  return (pc >> setBits) & ((1<<TAG_BITS) - 1);
+}
+
+static loop_entry_t *
+loop_lookup(uint32_t pc)
+{
+  loop_entry_t *set = &loopTable[(pc & setMask) * LOOP_WAYS];
+  uint16_t tag = loop_tag(pc);
+  for (int w = 0; w < LOOP_WAYS; w++) {
+    if (set[w].valid && set[w].tag == tag) {
+      return &set[w];
+    }
+  }
+  return NULL;
+}
+
+int
+loop_predict(uint32_t pc, uint8_t *prediction)
+{
+  loop_entry_t *e = loop_lookup(pc);
+  if (e == NULL || e->conf != CONF_MAX) {
+    return 0;
+  }
+  *prediction = (e->current + 1 == e->past) ? !e->dir : e->dir;
+  return 1;
+}
+
+void
+loop_train(uint32_t pc, uint8_t outcome, int mainCorrect)
+{
+  loop_entry_t *e = loop_lookup(pc);
+
+  if (e != NULL) {
+    // Judge the loop prediction before the entry moves on
+    if (e->conf == CONF_MAX) {
+      uint8_t loopPred = (e->current + 1 == e->past) ? !e->dir : e->dir;
+      if (loopPred != outcome) {
+        memset(e, 0, sizeof(*e));
+        return;
+      }
+      if (!mainCorrect && e->age < AGE_MAX) {
+        e->age++;
+      }
+    }
+
+    if (outcome == e->dir) {
+      if (e->current == ITER_MAX) {
+        // Trip count too long to track
+        memset(e, 0, sizeof(*e));
+        return;
+      }
+      e->current++;
+    } else {
+      // Loop exit
+      if (e->past == e->current + 1) {
+        if (e->conf < CONF_MAX) {
+          e->conf++;
+        }
+      } else {
+        e->past = e->current + 1;
+        e->conf = 0;
+      }
+      e->current = 0;
+    }
+    return;
+  }
+
+  if (mainCorrect) {
+    return;
+  }
+
+  // Allocate on a miss of the main predictor, usually at a loop
+  // exit, so the iterating direction is the opposite of 'outcome'
+  loop_entry_t *set = &loopTable[(pc & setMask) * LOOP_WAYS];
+  for (int w = 0; w < LOOP_WAYS; w++) {
+    if (set[w].age == 0) {
+      set[w].valid = 1;
+      set[w].tag = loop_tag(pc);
+      set[w].dir = !outcome;
+      set[w].past = 0;
+      set[w].current = 0;
+      set[w].conf = 0;
+      set[w].age = AGE_MAX;
+      return;
+    }
+  }
+  for (int w = 0; w < LOOP_WAYS; w++) {
+    set[w].age--;
+  }
+}
+
+uint32_t
+loop_storage_bits()
+{
+  // valid, tag, past and current trip counts, confidence, age, direction
+  uint32_t entryBits = 1 + TAG_BITS + 2*ITER_BITS + CONF_BITS + AGE_BITS + 1;
+  return (loopTable ? (LOOP_WAYS << setBits) : 0) * entryBits;
+}
+
+void
+loop_free()
+{
+  free(loopTable);
+  loopTable = NULL;
+}
+
+void
+loop_save(loop_state_t *state)
+{
+  state->table = loopTable;
+  state->setMask = setMask;
+  state->setBits = setBits;
+}
+
+void
+loop_load(const loop_state_t *state)
+{
+  loopTable = state->table;
+  setMask = state->setMask;
+  setBits = state->setBits;
+}
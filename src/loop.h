@@ -0,0 +1,51 @@
+//========================================================//
+//  loop.h                                                //
+//  Header file for the loop predictor                    //
+//                                                        //
+//  A small tagged side predictor that learns the trip    //
+//  count of loop branches and overrides the main         //
+//  prediction once it is confident                       //
+//========================================================//
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdint.h>
+
+// Allocate a loop predictor of 2^'bits' entries (4-way set
+// associative, so at least 4 entries)
+//
+void loop_init(int bits);
+
+// Look up the branch at 'pc'.  Returns True if the loop predictor
+// is confident, in which case '*prediction' holds its prediction
+//
+int loop_predict(uint32_t pc, uint8_t *prediction);
+
+// Train with the real 'outcome' of the branch at 'pc'.  'mainCorrect'
+// tells whether the main predictor got it right; entries are only
+// allocated for branches the main predictor misses
+//
+void loop_train(uint32_t pc, uint8_t outcome, int mainCorrect);
+
+// Bits of state kept by the loop predictor
+//
+uint32_t loop_storage_bits();
+
+// Free the loop table
+//
+void loop_free();
+
+// The loop predictor's tables, so several predictors can take turns
+// (see predictor_context_t)
+//
+typedef struct {
+  void *table;
+  uint32_t setMask;
+  int setBits;
+} loop_state_t;
+
+void loop_save(loop_state_t *state);
+void loop_load(const loop_state_t *state);
+
+#endif
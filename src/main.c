@@ -8,27 +8,135 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "predictor.h"
+#include "trace.h"
+#include "analyze.h"
+#include "alias.h"
+#include "alloc.h"
+#include "hash.h"
+#include "perf.h"
 
 FILE *stream;
+pid_t decoder = 0;
 char *buf = NULL;
 size_t len = 0;
 
+// Decoded trace cache (--cache)
+const char *cacheDir = NULL;
+trace_t cached;
+uint64_t cachedPos = 0;
+
+// Uncompressed trace file parsed straight from its mapping
+trace_text_t mapped;
+
+// Compare trace parsing throughput instead of simulating (--read-bench)
+int readBench = 0;
+
+// Time building and freeing the predictor instead (--init-bench)
+int initBench = 0;
+
+// Predictability analysis instead of simulation (--analyze)
+int analyzeBits = 0;
+
+// Report simulation time per branch (--time)
+int timing = 0;
+
+// Report predictor state size (--storage)
+int storage = 0;
+
+// Refuse predictors with more state bits than this (--budget)
+uint32_t budget = 0;
+
+// Report accuracy per confidence level (--confidence)
+int confidenceReport = 0;
+
+// Report chooser and component accuracy (--chooser)
+int chooserReport = 0;
+
+// Report hardware counters over the simulation (--perf)
+int perfReport = 0;
+
+// Branches predicted together per fetch block (--fetch)
+int fetchWidth = 1;
+
+// Statistics every 'window' branches, as CSV (--window)
+uint64_t window = 0;
+const char *windowPath = "window.csv";
+FILE *windowFile = NULL;
+uint64_t windowEnd = 0;
+uint64_t windowMispredictions = 0;
+
+// Traces given on the command line
+#define MAX_TRACES 64
+const char *tracePaths[MAX_TRACES];
+int ntraces = 0;
+int traceIndex = 0;   // Trace simulated by this process
+
 // Print out the Usage information to stderr
 //
 void
 usage()
 {
-  fprintf(stderr,"Usage: predictor <options> [<trace>]\n");
+  fprintf(stderr,"Usage: predictor <options> [<trace> ...]\n");
   fprintf(stderr,"       bunzip -kc trace.bz2 | predictor <options>\n");
+  fprintf(stderr,"       predictor <options> trace.bz2\n");
+  fprintf(stderr,"       predictor <options> fp_1.bz2 int_1.bz2 ...\n"
+                 "              (traces run concurrently, with a combined\n"
+                 "              report at the end)\n");
   fprintf(stderr," Options:\n");
   fprintf(stderr," --help       Print this message\n");
   fprintf(stderr," --verbose    Print predictions on stdout\n");
+  fprintf(stderr," --cache[=<dir>]  Share the decoded trace between runs\n"
+                 "              (default dir /dev/shm)\n");
+  fprintf(stderr," --alias      Report aliasing in the predictor tables\n");
+  fprintf(stderr," --time       Report simulation time per branch\n");
+  fprintf(stderr," --perf       Report cycles, instructions, IPC and cache,\n"
+                 "              TLB and branch misses of the simulation loop\n"
+                 "              per million branches\n");
+  fprintf(stderr," --hugepages  Back large tables with 2 MB pages\n");
+  fprintf(stderr," --storage    Report predictor state size in bits\n");
+  fprintf(stderr," --budget=<bits>  Exit with status 2 before simulating\n"
+                 "              if the predictor needs more state bits\n");
+  fprintf(stderr," --window:<# branches>  Write statistics for every window\n"
+                 "              of branches as CSV (rate, misses per 1000\n"
+                 "              branches, table occupancy, chooser bias)\n");
+  fprintf(stderr," --window-file=<path>  CSV file for --window (default\n"
+                 "              window.csv, suffixed .<n> per trace)\n");
+  fprintf(stderr," --confidence Report accuracy per prediction confidence\n");
+  fprintf(stderr," --chooser    Report chooser and component accuracy\n"
+                 "              (tournament and custom)\n");
+  fprintf(stderr," --jrs[:<# entries bits>]  Use a JRS confidence estimator\n"
+                 "              (default 2^ghistory entries)\n");
+  fprintf(stderr," --fetch:<# branches>  Predict blocks of branches with the\n"
+                 "              history at block start (at most %d)\n", MAX_BATCH);
+  fprintf(stderr," --delay:<# branches>  Train counters this many branches\n"
+                 "              after predicting, with speculative history\n");
+  fprintf(stderr," --loop[:<# entries bits>]  Add a loop predictor to the\n"
+                 "              scheme (default 64 entries)\n");
+  fprintf(stderr," --entries:<n> Size the global tables to n entries, at\n"
+                 "              most 2^ghistory (need not be a power of 2)\n");
+  fprintf(stderr," --hash=<fn>  Global table index hash:\n"
+                 "    hist, xor, fold, select, skew, crc\n"
+                 "    (default xor, or hist for tournament)\n");
+  fprintf(stderr," --read-bench Compare parsing an uncompressed trace\n"
+                 "              through stdio and mmap, and decoding\n"
+                 "              it packed in memory\n");
+  fprintf(stderr," --init-bench Time building and freeing the predictor\n");
+  fprintf(stderr," --analyze[:<# table bits>]  Report trace predictability\n"
+                 "              instead of simulating (default 13 bits)\n");
   fprintf(stderr," --<type>     Branch prediction scheme:\n");
   fprintf(stderr,"    static\n"
                  "    gshare:<# ghistory>\n"
                  "    tournament:<# ghistory>:<# lhistory>:<# index>\n"
-                 "    custom\n");
+                 "    custom[:<# ghistory>:<# lhistory>:<# index>]\n"
+                 "    bimode:<# ghistory>\n"
+                 "    gskew:<# ghistory>\n"
+                 "    perceptron:<# history>:<# rows>[:<weight bits>[:<theta>]]\n"
+                 "      (default 8-bit weights, theta 1.93*history + 14)\n");
 }
 
 // Process an option and update the predictor
@@ -49,8 +157,88 @@ handle_option(char *arg)
     sscanf(arg+13,"%d:%d:%d", &ghistoryBits, &lhistoryBits, &pcIndexBits);
   } else if (!strcmp(arg,"--custom")) {
     bpType = CUSTOM;
+    ghistoryBits = lhistoryBits = pcIndexBits = 0;
+  } else if (!strncmp(arg,"--custom:",9)) {
+    bpType = CUSTOM;
+    sscanf(arg+9,"%d:%d:%d", &ghistoryBits, &lhistoryBits, &pcIndexBits);
+  } else if (!strncmp(arg,"--bimode:",9)) {
+    bpType = BIMODE;
+    sscanf(arg+9,"%d", &ghistoryBits);
+  } else if (!strncmp(arg,"--gskew:",8)) {
+    bpType = GSKEW;
+    sscanf(arg+8,"%d", &ghistoryBits);
+  } else if (!strncmp(arg,"--perceptron:",13)) {
+    bpType = PERCEPTRON;
+    percWeightBits = 8;
+    percTheta = 0;
+    return sscanf(arg+13,"%d:%d:%d:%d", &percHistory, &percRows,
+                  &percWeightBits, &percTheta) >= 2 &&
+           percHistory > 0 && percRows > 0 &&
+           percWeightBits >= 2 && percWeightBits <= 32;
+  } else if (!strncmp(arg,"--window:",9)) {
+    window = strtoull(arg+9, NULL, 10);
+    return window > 0;
+  } else if (!strncmp(arg,"--window-file=",14)) {
+    windowPath = arg+14;
+  } else if (!strcmp(arg,"--chooser")) {
+    chooserReport = 1;
+  } else if (!strcmp(arg,"--confidence")) {
+    confidenceReport = 1;
+  } else if (!strcmp(arg,"--jrs")) {
+    jrsBits = -1;
+    confidenceReport = 1;
+  } else if (!strncmp(arg,"--jrs:",6)) {
+    sscanf(arg+6,"%d", &jrsBits);
+    confidenceReport = 1;
+    return jrsBits >= 1 && jrsBits <= MAX_JRS_BITS;
+  } else if (!strncmp(arg,"--fetch:",8)) {
+    sscanf(arg+8,"%d", &fetchWidth);
+    return fetchWidth >= 1 && fetchWidth <= MAX_BATCH;
+  } else if (!strncmp(arg,"--delay:",8)) {
+    sscanf(arg+8,"%d", &updateDelay);
+    return updateDelay >= 0 && updateDelay <= MAX_DELAY;
+  } else if (!strcmp(arg,"--loop")) {
+    loopBits = 6;
+  } else if (!strncmp(arg,"--loop:",7)) {
+    sscanf(arg+7,"%d", &loopBits);
+    return loopBits >= 1 && loopBits <= MAX_LOOP_BITS;
+  } else if (!strcmp(arg,"--storage")) {
+    storage = 1;
+  } else if (!strncmp(arg,"--budget=",9)) {
+    budget = strtoul(arg+9, NULL, 10);
+    return budget > 0;
   } else if (!strcmp(arg,"--verbose")) {
     verbose = 1;
+  } else if (!strcmp(arg,"--cache")) {
+    struct stat st;
+    cacheDir = (stat("/dev/shm", &st) == 0) ? "/dev/shm" : "/tmp";
+  } else if (!strncmp(arg,"--cache=",8)) {
+    cacheDir = arg+8;
+  } else if (!strncmp(arg,"--entries:",10)) {
+    sscanf(arg+10,"%d", &globalEntries);
+  } else if (!strncmp(arg,"--hash=",7)) {
+    for (indexHash = NHASHES-1; indexHash >= 0; indexHash--) {
+      if (!strcmp(arg+7, hashName[indexHash])) {
+        break;
+      }
+    }
+    return indexHash >= 0;
+  } else if (!strcmp(arg,"--time")) {
+    timing = 1;
+  } else if (!strcmp(arg,"--perf")) {
+    perfReport = 1;
+  } else if (!strcmp(arg,"--hugepages")) {
+    hugePages = 1;
+  } else if (!strcmp(arg,"--alias")) {
+    aliasTrack = 1;
+  } else if (!strcmp(arg,"--read-bench")) {
+    readBench = 1;
+  } else if (!strcmp(arg,"--init-bench")) {
+    initBench = 1;
+  } else if (!strcmp(arg,"--analyze")) {
+    analyzeBits = 13;
+  } else if (!strncmp(arg,"--analyze:",10)) {
+    sscanf(arg+10,"%d", &analyzeBits);
   } else {
     return 0;
   }
@@ -66,6 +254,19 @@ handle_option(char *arg)
 int
 read_branch(uint32_t *pc, uint8_t *outcome)
 {
+  if (cached.pc != NULL) {
+    if (cachedPos == cached.count) {
+      return 0;
+    }
+    *pc = cached.pc[cachedPos];
+    *outcome = cached.outcome[cachedPos];
+    cachedPos++;
+    return 1;
+  }
+  if (mapped.data != NULL) {
+    return trace_next_text(&mapped, pc, outcome);
+  }
+
   if (getline(&buf, &len, stream) == -1) {
     return 0;
   }
@@ -77,14 +278,329 @@ read_branch(uint32_t *pc, uint8_t *outcome)
   return 1;
 }
 
+// Build and free the configured predictor INIT_RUNS times and report
+// the fastest and mean time of each step.  Mapped tables that start
+// at zero are only reserved here, their pages faulted in as the trace
+// touches them; tables of any other initial value are written in full
+//
+#define INIT_RUNS 20
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) +
+         (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void
+init_benchmark()
+{
+  double best[2] = { 0, 0 };
+  double total[2] = { 0, 0 };
+  size_t bytes = 0;
+  size_t filled = 0;
+
+  for (int run = 0; run < INIT_RUNS; run++) {
+    struct timespec start, mid, end;
+    size_t before = filled_bytes();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    init_predictor();
+    clock_gettime(CLOCK_MONOTONIC, &mid);
+    bytes = table_bytes();
+    filled = filled_bytes() - before;
+    free_predictor();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs[2] = { elapsed(&start, &mid), elapsed(&mid, &end) };
+    for (int i = 0; i < 2; i++) {
+      if (run == 0 || secs[i] < best[i]) {
+        best[i] = secs[i];
+      }
+      total[i] += secs[i];
+    }
+  }
+
+  const char *name[2] = { "init", "free" };
+  printf("Table bytes: %zu\n", bytes);
+  printf("Filled bytes: %zu (%.1f%%, pattern written at init)\n", filled,
+         bytes ? 100.0 * filled / bytes : 0);
+  printf("Step     Best us   Mean us\n");
+  for (int i = 0; i < 2; i++) {
+    printf("%-5s  %9.1f %9.1f\n", name[i], best[i] * 1e6,
+           total[i] / INIT_RUNS * 1e6);
+  }
+}
+
+// Parse the uncompressed trace at 'path' through stdio as read_branch
+// does for streams, then through the mapping, then decode it from
+// its packed form, and report the throughput of each.  Each pass runs
+// twice and the faster run counts, so all see the file in the page
+// cache.  MB/s is always of the text file, for comparison
+//
+void
+read_benchmark(const char *path)
+{
+  double best[3] = { 0, 0, 0 };
+  uint64_t counts[3] = { 0, 0, 0 };
+  size_t bytes = 0;
+
+  // Packing is done once, as a sweep would before its runs
+  trace_t whole;
+  trace_packed_t packed;
+  stream = fopen(path, "r");
+  if (stream == NULL || !trace_read_all(stream, &whole) ||
+      !trace_pack(&whole, whole.count, &packed)) {
+    fprintf(stderr,"Cannot read and pack trace %s\n", path);
+    exit(1);
+  }
+  fclose(stream);
+  stream = stdin;
+
+  for (int run = 0; run < 6; run++) {
+    int useMap = run / 2;
+    uint64_t count = 0;
+    uint32_t pc;
+    uint8_t outcome;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (useMap == 2) {
+      uint32_t pcs[TRACE_BLOCK];
+      uint8_t outcomes[TRACE_BLOCK];
+      int n;
+      while ((n = trace_unpack(&packed, count, pcs, outcomes)) > 0) {
+        // Check the decoded branches against the unpacked trace
+        if (memcmp(pcs, whole.pc + count, n * sizeof(uint32_t)) ||
+            memcmp(outcomes, whole.outcome + count, n)) {
+          fprintf(stderr,"Packed trace differs near branch %llu\n",
+                  (unsigned long long)count);
+          exit(1);
+        }
+        count += n;
+      }
+    } else if (useMap) {
+      if (!trace_map_text(path, &mapped)) {
+        fprintf(stderr,"Cannot map %s (an uncompressed file is needed)\n",
+                path);
+        exit(1);
+      }
+      bytes = mapped.len;
+      while (trace_next_text(&mapped, &pc, &outcome)) {
+        count++;
+      }
+      trace_unmap_text(&mapped);
+    } else {
+      stream = fopen(path, "r");
+      if (stream == NULL) {
+        fprintf(stderr,"Cannot open trace %s\n", path);
+        exit(1);
+      }
+      while (read_branch(&pc, &outcome)) {
+        count++;
+      }
+      fclose(stream);
+      stream = stdin;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = elapsed(&start, &end);
+    if (best[useMap] == 0 || secs < best[useMap]) {
+      best[useMap] = secs;
+    }
+    counts[useMap] = count;
+  }
+
+  const char *name[3] = { "stdio", "mmap", "packed" };
+  printf("Input     Branches      MB/s  ns/branch\n");
+  for (int i = 0; i < 3; i++) {
+    printf("%-6s  %10llu  %8.1f  %9.2f\n", name[i],
+           (unsigned long long)counts[i], bytes / best[i] / 1e6,
+           counts[i] ? best[i] * 1e9 / counts[i] : 0);
+  }
+  size_t packedBytes = trace_packed_bytes(&packed);
+  printf("Packed bytes: %zu (%.2f per branch, %u distinct PCs)\n",
+         packedBytes, whole.count ? (double)packedBytes / whole.count : 0,
+         packed.npcs);
+  if (counts[0] != counts[1] || counts[0] != counts[2]) {
+    fprintf(stderr,"Branch counts differ\n");
+    exit(1);
+  }
+  trace_free_packed(&packed);
+  trace_detach(&whole);
+}
+
+// Write a CSV row once 'num_branches' reaches the end of the current
+// window, or for the partial window left at the end of the trace.
+// The per-branch cost is one comparison
+//
+static inline void
+window_check(uint64_t num_branches, uint64_t mispredictions, int last)
+{
+  if (num_branches < windowEnd &&
+      !(last && num_branches > windowEnd - window)) {
+    return;
+  }
+  uint64_t n = num_branches - (windowEnd - window);
+  uint64_t misses = mispredictions - windowMispredictions;
+  table_stats_t stats;
+  table_stats(&stats);
+
+  fprintf(windowFile, "%llu,%llu,%llu,%.4f,%.3f,",
+          (unsigned long long)num_branches, (unsigned long long)n,
+          (unsigned long long)misses, 100.0 * misses / n, 1000.0 * misses / n);
+  if (stats.occupancy >= 0) {
+    fprintf(windowFile, "%.4f", stats.occupancy);
+  }
+  fprintf(windowFile, ",");
+  if (stats.chooserGlobal >= 0) {
+    fprintf(windowFile, "%.4f", stats.chooserGlobal);
+  }
+  fprintf(windowFile, "\n");
+
+  windowMispredictions = mispredictions;
+  windowEnd = num_branches + window;
+}
+
+// Simulate a front end that predicts 'fetchWidth' branches at a time,
+// all with the history available at the start of the block
+//
+void
+simulate_fetch_blocks(uint64_t *num_branches, uint64_t *mispredictions)
+{
+  uint32_t pcs[MAX_BATCH];
+  uint8_t outcomes[MAX_BATCH];
+  uint8_t predictions[MAX_BATCH];
+  int n;
+
+  do {
+    for (n = 0; n < fetchWidth && read_branch(&pcs[n], &outcomes[n]); n++);
+    predict_batch(pcs, n, predictions);
+
+    for (int i = 0; i < n; i++) {
+      (*num_branches)++;
+      if (predictions[i] != outcomes[i]) {
+        (*mispredictions)++;
+      }
+      if (verbose != 0) {
+        printf ("%d\n", predictions[i]);
+      }
+    }
+    train_batch(pcs, outcomes, n);
+    if (window) {
+      window_check(*num_branches, *mispredictions, n < fetchWidth);
+    }
+  } while (n == fetchWidth);
+}
+
+// Value of the report line starting with 'label' in 'report'
+//
+// Returns True if Found
+//
+int
+report_value(const char *report, const char *label, uint64_t *value)
+{
+  for (const char *line = report; line != NULL; line = strchr(line, '\n')) {
+    line += (*line == '\n');
+    if (!strncmp(line, label, strlen(label))) {
+      *value = strtoull(line + strlen(label), NULL, 10);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Simulate each of the 'ntraces' traces in its own process, so they
+// run concurrently with their own predictor state.  Each child returns
+// here with the index of its trace and carries on as a single trace
+// run, its report going to a temporary file.  The parent waits for
+// all of them, prints every report followed by the combined rates,
+// and returns -1
+//
+int
+fork_traces()
+{
+  FILE *reports[MAX_TRACES];
+  pid_t pids[MAX_TRACES];
+
+  fflush(stdout);
+  for (int t = 0; t < ntraces; t++) {
+    reports[t] = tmpfile();
+    if (reports[t] == NULL) {
+      perror("tmpfile");
+      exit(1);
+    }
+    pids[t] = fork();
+    if (pids[t] < 0) {
+      perror("fork");
+      exit(1);
+    }
+    if (pids[t] == 0) {
+      dup2(fileno(reports[t]), STDOUT_FILENO);
+      return t;
+    }
+  }
+
+  uint64_t totalBranches = 0, totalIncorrect = 0;
+  double rateSum = 0;
+  int failed = 0;
+
+  for (int t = 0; t < ntraces; t++) {
+    int status;
+    waitpid(pids[t], &status, 0);
+
+    // Read the whole report back
+    fseek(reports[t], 0, SEEK_END);
+    long size = ftell(reports[t]);
+    char *report = calloc(size + 1, 1);
+    rewind(reports[t]);
+    size = fread(report, 1, size, reports[t]);
+    fclose(reports[t]);
+
+    printf("Trace: %s\n%s", tracePaths[t], report);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("Failed (status %d)\n", status);
+      failed = 1;
+    }
+
+    uint64_t branches, incorrect;
+    if (report_value(report, "Branches:", &branches) &&
+        report_value(report, "Incorrect:", &incorrect) && branches > 0) {
+      totalBranches += branches;
+      totalIncorrect += incorrect;
+      rateSum += 100.0 * incorrect / branches;
+    } else {
+      failed = 1;
+    }
+    printf("\n");
+    free(report);
+  }
+
+  if (!failed) {
+    printf("Traces:          %10d\n", ntraces);
+    printf("Total Branches:  %10llu\n", (unsigned long long)totalBranches);
+    printf("Total Incorrect: %10llu\n", (unsigned long long)totalIncorrect);
+    printf("Mean Rate:          %7.3f\n", rateSum / ntraces);
+    printf("Weighted Rate:      %7.3f\n",
+           100.0 * totalIncorrect / totalBranches);
+  }
+  fflush(stdout);
+  if (failed) {
+    exit(1);
+  }
+  return -1;
+}
+
 int
 main(int argc, char *argv[])
 {
   // Set defaults
   stream = stdin;
   bpType = STATIC;
+  indexHash = -1;
   verbose = 0;
 
+  const char *tracePath = NULL;
+
   // Process cmdline Arguments
   for (int i = 1; i < argc; ++i) {
     if (!strcmp(argv[i],"--help")) {
@@ -96,22 +612,150 @@ main(int argc, char *argv[])
         usage();
         exit(1);
       }
-    } else {
+    } else if (ntraces < MAX_TRACES) {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      tracePaths[ntraces++] = argv[i];
+    } else {
+      fprintf(stderr,"At most %d traces\n", MAX_TRACES);
+      exit(1);
     }
   }
 
-  // Initialize the predictor
-  init_predictor();
+  // Reject a predictor over the storage budget before touching the trace
+  if (budget > 0) {
+    init_predictor();
+    uint32_t bits = storage_bits();
+    free_predictor();
+    if (bits > budget) {
+      fprintf(stderr,"Predictor needs %u bits, over the budget of %u\n",
+              bits, budget);
+      exit(2);
+    }
+  }
+
+  if (initBench) {
+    init_benchmark();
+    return 0;
+  }
+
+  // With several traces this process only collects the reports
+  if (ntraces > 1) {
+    int t = fork_traces();
+    if (t < 0) {
+      return 0;
+    }
+    traceIndex = t;
+    tracePath = tracePaths[t];
+  } else if (ntraces == 1) {
+    tracePath = tracePaths[0];
+  }
+
+  if (readBench) {
+    if (tracePath == NULL) {
+      fprintf(stderr,"--read-bench needs a trace file\n");
+      exit(1);
+    }
+    read_benchmark(tracePath);
+    return 0;
+  }
+
+  // Attach to the shared decoded trace, parse an uncompressed file
+  // straight from a mapping, or stream the file.  Fetch mode reads
+  // the whole trace into memory from a stream instead
+  if (tracePath != NULL) {
+    if (cacheDir == NULL ||
+        !trace_attach_cached(tracePath, cacheDir, &cached)) {
+      if (cacheDir != NULL) {
+        fprintf(stderr,"Trace cache unavailable, streaming %s\n", tracePath);
+      }
+      if (fetchWidth == 1 && trace_map_text(tracePath, &mapped)) {
+        stream = NULL;
+      } else {
+        stream = trace_open_stream(tracePath, &decoder);
+      }
+      if (stream == NULL && mapped.data == NULL) {
+        fprintf(stderr,"Cannot open trace %s\n", tracePath);
+        exit(1);
+      }
+    }
+  }
 
-  uint32_t num_branches = 0;
-  uint32_t mispredictions = 0;
+  uint64_t num_branches = 0;
+  uint64_t mispredictions = 0;
   uint32_t pc = 0;
   uint8_t outcome = NOTTAKEN;
 
+  // Only characterize the trace
+  if (analyzeBits > 0) {
+    analyze_init(analyzeBits);
+    while (read_branch(&pc, &outcome)) {
+      analyze_branch(pc, outcome);
+    }
+    analyze_report();
+    trace_detach(&cached);
+    trace_unmap_text(&mapped);
+    trace_close_stream(stream, decoder);
+    free(buf);
+    return 0;
+  }
+
+  if (fetchWidth > 1 && updateDelay > 0) {
+    fprintf(stderr,"--fetch and --delay cannot be combined\n");
+    exit(1);
+  }
+  if (fetchWidth > 1 && confidenceReport) {
+    fprintf(stderr,"--fetch cannot be combined with --confidence or --jrs\n");
+    exit(1);
+  }
+
+  // The block model is compared with a serial pass over the same trace
+  uint64_t serialMispredictions = 0;
+  if (fetchWidth > 1) {
+    if (cached.pc == NULL && !trace_read_all(stream, &cached)) {
+      fprintf(stderr,"Cannot read the trace into memory\n");
+      exit(1);
+    }
+    init_predictor();
+    while (read_branch(&pc, &outcome)) {
+      serialMispredictions += make_prediction(pc) != outcome;
+      train_predictor(pc, outcome);
+    }
+    free_predictor();
+    cachedPos = 0;
+  }
+
+  // Initialize the predictor
+  init_predictor();
+
+  if (window) {
+    // Concurrent traces each get their own file
+    char name[4096];
+    snprintf(name, sizeof(name), ntraces > 1 ? "%s.%d" : "%s", windowPath,
+             traceIndex);
+    windowFile = fopen(name, "w");
+    if (windowFile == NULL) {
+      fprintf(stderr,"Cannot write %s\n", name);
+      exit(1);
+    }
+    fprintf(windowFile, "branches,window,incorrect,rate,mpkb,occupancy,"
+                        "chooser_global\n");
+    windowEnd = window;
+  }
+
+  uint64_t confBranches[NCONF] = { 0 };
+  uint64_t confMispredictions[NCONF] = { 0 };
+
+  struct timespec start, end;
+  if (perfReport) {
+    perf_start();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
   // Reach each branch from the trace
-  while (read_branch(&pc, &outcome)) {
+  if (fetchWidth > 1) {
+    simulate_fetch_blocks(&num_branches, &mispredictions);
+  }
+  while (fetchWidth == 1 && read_branch(&pc, &outcome)) {
     num_branches++;
 
     // Make a prediction and compare with actual outcome
@@ -119,22 +763,104 @@ main(int argc, char *argv[])
     if (prediction != outcome) {
       mispredictions++;
     }
+    if (confidenceReport) {
+      uint8_t conf = prediction_confidence();
+      confBranches[conf]++;
+      confMispredictions[conf] += prediction != outcome;
+    }
     if (verbose != 0) {
       printf ("%d\n", prediction);
     }
 
     // Train the predictor
     train_predictor(pc, outcome);
+    if (window && num_branches == windowEnd) {
+      window_check(num_branches, mispredictions, 0);
+    }
+  }
+  flush_predictor();
+  if (window && fetchWidth == 1) {
+    window_check(num_branches, mispredictions, 1);
+  }
+  if (windowFile != NULL) {
+    fclose(windowFile);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (perfReport) {
+    perf_stop();
   }
 
   // Print out the mispredict statistics
-  printf("Branches:        %10d\n", num_branches);
-  printf("Incorrect:       %10d\n", mispredictions);
-  float mispredict_rate = 100*((float)mispredictions / (float)num_branches);
+  printf("Branches:        %10llu\n", (unsigned long long)num_branches);
+  printf("Incorrect:       %10llu\n", (unsigned long long)mispredictions);
+  double mispredict_rate = 100.0 * mispredictions / num_branches;
   printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  if (fetchWidth > 1) {
+    double serial_rate = 100.0 * serialMispredictions / num_branches;
+    printf("Fetch width:     %10d\n", fetchWidth);
+    printf("Serial Incorrect:%10llu\n",
+           (unsigned long long)serialMispredictions);
+    printf("Serial Rate:        %7.3f\n", serial_rate);
+    printf("Block Loss:         %7.3f\n", mispredict_rate - serial_rate);
+  }
+  if (storage) {
+    storage_item_t items[MAX_STORAGE_ITEMS];
+    int n = storage_items(items);
+    printf("Storage bits:    %10u\n", storage_bits());
+    for (int i = 0; i < n; i++) {
+      printf("  %-15s%10u\n", items[i].name, items[i].bits);
+    }
+  }
+  if (hugePages) {
+    printf("Huge page bytes: %10zu\n", huge_bytes());
+  }
+  if (perfReport) {
+    perf_report(num_branches);
+  }
+  if (timing) {
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 +
+                (end.tv_nsec - start.tv_nsec);
+    printf("Time per branch:  %7.2f ns\n", num_branches ? ns / num_branches : 0);
+  }
+  if (confidenceReport) {
+    printf("Confidence    Branches   Incorrect  Misprediction Rate\n");
+    for (int i = 0; i < NCONF; i++) {
+      printf("%-10s  %10llu  %10llu  %7.3f\n", confName[i],
+             (unsigned long long)confBranches[i],
+             (unsigned long long)confMispredictions[i], confBranches[i] ?
+             100.0 * confMispredictions[i] / confBranches[i] : 0);
+    }
+  }
+  if (chooserReport && chooser_stats()->branches > 0) {
+    const chooser_stats_t *c = chooser_stats();
+    double total = c->branches;
+    printf("Chose Local:     %10llu  %7.3f%%\n",
+           (unsigned long long)c->choseLocal, 100 * c->choseLocal / total);
+    printf("Chose Global:    %10llu  %7.3f%%\n",
+           (unsigned long long)c->choseGlobal, 100 * c->choseGlobal / total);
+    printf("Component       Incorrect  Misprediction Rate\n");
+    printf("%-14s  %10llu  %7.3f\n", "Local",
+           (unsigned long long)(c->branches - c->localCorrect),
+           100 * (1 - c->localCorrect / total));
+    printf("%-14s  %10llu  %7.3f\n", "Global",
+           (unsigned long long)(c->branches - c->globalCorrect),
+           100 * (1 - c->globalCorrect / total));
+    printf("%-14s  %10llu  %7.3f\n", "Chooser",
+           (unsigned long long)(c->branches - c->chosenCorrect),
+           100 * (1 - c->chosenCorrect / total));
+    printf("%-14s  %10llu  %7.3f\n", "Oracle",
+           (unsigned long long)(c->branches - c->oracleCorrect),
+           100 * (1 - c->oracleCorrect / total));
+  }
+  if (aliasTrack) {
+    alias_report();
+  }
 
   // Cleanup
-  fclose(stream);
+  trace_detach(&cached);
+  trace_unmap_text(&mapped);
+  trace_close_stream(stream, decoder);
   free(buf);
 
   return 0;
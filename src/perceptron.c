@@ -0,0 +1,339 @@
+//========================================================//
+//  perceptron.c                                          //
+//  Source file for the perceptron predictor              //
+//                                                        //
+//  Weights are laid out row by row in one array whose    //
+//  element type is the narrowest that holds a weight of  //
+//  the configured width, so narrow weights pack more     //
+//  perceptrons per cache line.  Rows are padded to whole //
+//  SSE2 vectors, then to a whole fraction or multiple of //
+//  a cache line so that none straddles two lines.  8-bit //
+//  rows are read and trained 16 weights at a time.  The  //
+//  history is a ring whose position can be saved and     //
+//  restored like the global history of other schemes     //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "predictor.h"
+#include "perceptron.h"
+#include "alloc.h"
+#include "hash.h"
+
+#define LANES 16           // 8-bit weights per vector
+#define LINE  64           // Cache line bytes
+
+static void *weights;      // rows x stride history weights
+static int32_t *bias;      // one bias weight per row
+static int weightBytes;    // 1, 2 or 4
+static int stride;         // weights per row, histLen padded to LANES
+                           // and to a whole fraction or multiple of
+                           // a cache line
+static int histLen;
+static int nrows;
+static int wbits;
+static int threshold;
+static int wmax, wmin;
+static int8_t *history;    // ring of ringLen outcomes, +1 taken,
+                           // -1 not taken, each stored twice so any
+                           // window of histLen is contiguous
+static int ringLen;        // histLen plus the branches in flight
+static uint32_t head;      // ring slot of the next outcome
+static int8_t *laneMask;   // -1 for the histLen real weights of a
+                           // row, 0 for padding
+
+//------------------------------------//
+//    Perceptron Predictor Functions  //
+//------------------------------------//
+
+void
+perceptron_init(int hist, int rows, int weightBits, int theta)
+{
+  histLen = hist < 1 ? 1 : hist;
+  nrows = rows < 1 ? 1 : rows;
+  wbits = weightBits < 2 ? 2 : weightBits > 32 ? 32 : weightBits;
+  threshold = theta > 0 ? theta : (int)(1.93 * histLen + 14);
+  wmax = (int)((1u << (wbits - 1)) - 1);
+  wmin = -wmax - 1;
+  weightBytes = wbits <= 8 ? 1 : wbits <= 16 ? 2 : 4;
+  stride = (histLen + LANES - 1) / LANES * LANES;
+
+  // table_alloc aligns the table to a cache line; a row that is not a
+  // divisor or a multiple of the line would straddle two of them
+  int rowBytes = stride * weightBytes;
+  if (rowBytes > LINE) {
+    rowBytes = (rowBytes + LINE - 1) / LINE * LINE;
+  } else {
+    while (LINE % rowBytes != 0) {
+      rowBytes += LANES;
+    }
+  }
+  stride = rowBytes / weightBytes;
+
+  // Outcomes pushed since the oldest history still to be restored
+  // (a delayed or fetch block branch) must not reach its window
+  ringLen = histLen + (updateDelay > 0 ? updateDelay : 0) + MAX_BATCH + 1;
+  head = 0;
+
+  // Padding weights stay zero, so the vector loops may read past the
+  // window into whatever the ring holds there
+  table_free(weights);
+  free(bias);
+  free(history);
+  free(laneMask);
+  weights = table_alloc((size_t)nrows * stride * weightBytes);
+  bias = calloc(nrows, sizeof(int32_t));
+  history = malloc(2 * ringLen + stride);
+  memset(history, -1, 2 * ringLen + stride);
+  laneMask = calloc(stride, 1);
+  memset(laneMask, -1, histLen);
+}
+
+// The last histLen outcomes, oldest first
+//
+static inline const int8_t *
+window()
+{
+  return history + (head + ringLen - histLen) % ringLen;
+}
+
+// Row of the perceptron for 'pc'.  The pc is scrambled first so the
+// multiply-shift reduction sees its low bits
+//
+static inline uint32_t
+perceptron_row(uint32_t pc)
+{
+  return fast_range(pc * 0x9e3779b1u, nrows, 32);
+}
+
+// Output of row 'row': the bias plus the weights of taken branches
+// minus the weights of not taken ones
+//
+static int
+dot(uint32_t row)
+{
+  size_t base = (size_t)row * stride;
+  int sum = bias[row];
+  const int8_t *h = window();
+
+  switch (weightBytes) {
+    case 1: {
+      const int8_t *w = (const int8_t *)weights + base;
+#ifdef __SSE2__
+      // Sign extend both operands to 16 bits and multiply-add pairs
+      // into four 32-bit partial sums
+      __m128i acc = _mm_setzero_si128();
+      for (int i = 0; i < stride; i += LANES) {
+        __m128i wv = _mm_load_si128((const __m128i *)(w + i));
+        __m128i hv = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i wlo = _mm_srai_epi16(_mm_unpacklo_epi8(wv, wv), 8);
+        __m128i whi = _mm_srai_epi16(_mm_unpackhi_epi8(wv, wv), 8);
+        __m128i hlo = _mm_srai_epi16(_mm_unpacklo_epi8(hv, hv), 8);
+        __m128i hhi = _mm_srai_epi16(_mm_unpackhi_epi8(hv, hv), 8);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(wlo, hlo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(whi, hhi));
+      }
+      acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+      acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+      return sum + _mm_cvtsi128_si32(acc);
+#else
+      for (int i = 0; i < histLen; i++) {
+        sum += w[i] * h[i];
+      }
+      return sum;
+#endif
+    }
+    case 2: {
+      const int16_t *w = (const int16_t *)weights + base;
+      for (int i = 0; i < histLen; i++) {
+        sum += w[i] * h[i];
+      }
+      return sum;
+    }
+    default: {
+      const int32_t *w = (const int32_t *)weights + base;
+      int64_t wide = sum;
+      for (int i = 0; i < histLen; i++) {
+        wide += (int64_t)w[i] * h[i];
+      }
+      return wide > INT32_MAX ? INT32_MAX : wide < INT32_MIN ? INT32_MIN :
+             (int)wide;
+    }
+  }
+}
+
+// Weight 'w' moved one step in direction 'delta', saturating at the
+// configured width
+//
+static inline int32_t
+step(int32_t w, int delta)
+{
+  int64_t v = (int64_t)w + delta;
+  return v > wmax ? wmax : v < wmin ? wmin : (int32_t)v;
+}
+
+// Move every weight of 'row' towards 'outcome'
+//
+static void
+adjust(uint32_t row, uint8_t outcome)
+{
+  size_t base = (size_t)row * stride;
+  int out = outcome ? 1 : -1;
+  const int8_t *h = window();
+
+  bias[row] = step(bias[row], out);
+  switch (weightBytes) {
+    case 1: {
+      int8_t *w = (int8_t *)weights + base;
+#ifdef __SSE2__
+      // Add the +-1 steps with 8-bit saturation, then clamp to the
+      // configured width when it is narrower than 8 bits
+      __m128i zero = _mm_setzero_si128();
+      __m128i hi = _mm_set1_epi8((char)wmax);
+      __m128i lo = _mm_set1_epi8((char)wmin);
+      for (int i = 0; i < stride; i += LANES) {
+        __m128i wv = _mm_load_si128((__m128i *)(w + i));
+        __m128i dv = _mm_loadu_si128((const __m128i *)(h + i));
+        dv = _mm_and_si128(dv, _mm_loadu_si128((const __m128i *)
+                                               (laneMask + i)));
+        if (!outcome) {
+          dv = _mm_sub_epi8(zero, dv);
+        }
+        wv = _mm_adds_epi8(wv, dv);
+        if (wbits < 8) {
+          __m128i over = _mm_cmpgt_epi8(wv, hi);
+          wv = _mm_or_si128(_mm_and_si128(over, hi),
+                            _mm_andnot_si128(over, wv));
+          __m128i under = _mm_cmpgt_epi8(lo, wv);
+          wv = _mm_or_si128(_mm_and_si128(under, lo),
+                            _mm_andnot_si128(under, wv));
+        }
+        _mm_store_si128((__m128i *)(w + i), wv);
+      }
+#else
+      for (int i = 0; i < histLen; i++) {
+        w[i] = step(w[i], out * h[i]);
+      }
+#endif
+      break;
+    }
+    case 2: {
+      int16_t *w = (int16_t *)weights + base;
+      for (int i = 0; i < histLen; i++) {
+        w[i] = step(w[i], out * h[i]);
+      }
+      break;
+    }
+    default: {
+      int32_t *w = (int32_t *)weights + base;
+      for (int i = 0; i < histLen; i++) {
+        w[i] = step(w[i], out * h[i]);
+      }
+      break;
+    }
+  }
+}
+
+uint8_t
+perceptron_predict(uint32_t pc, int *sum)
+{
+  *sum = dot(perceptron_row(pc));
+  return *sum >= 0 ? TAKEN : NOTTAKEN;
+}
+
+void
+perceptron_train(uint32_t pc, uint8_t outcome)
+{
+  uint32_t row = perceptron_row(pc);
+  int sum = dot(row);
+
+  // Train on a miss, or while the output is not yet beyond threshold
+  if ((sum >= 0) != outcome || abs(sum) <= threshold) {
+    adjust(row, outcome);
+  }
+}
+
+void
+perceptron_push(uint8_t outcome)
+{
+  history[head] = history[head + ringLen] = outcome ? 1 : -1;
+  head = (head + 1) % ringLen;
+}
+
+uint32_t
+perceptron_history()
+{
+  return head;
+}
+
+void
+perceptron_restore(uint32_t position)
+{
+  head = position;
+}
+
+int
+perceptron_theta()
+{
+  return threshold;
+}
+
+uint32_t
+perceptron_storage_bits()
+{
+  return weights ? (uint32_t)nrows * (histLen + 1) * wbits + histLen : 0;
+}
+
+void
+perceptron_free()
+{
+  table_free(weights);
+  free(bias);
+  free(history);
+  free(laneMask);
+  weights = NULL;
+  bias = NULL;
+  history = NULL;
+  laneMask = NULL;
+}
+
+void
+perceptron_save(perceptron_state_t *state)
+{
+  state->weights = weights;
+  state->bias = bias;
+  state->history = history;
+  state->laneMask = laneMask;
+  state->ringLen = ringLen;
+  state->head = head;
+  state->weightBytes = weightBytes;
+  state->stride = stride;
+  state->histLen = histLen;
+  state->nrows = nrows;
+  state->wbits = wbits;
+  state->threshold = threshold;
+  state->wmax = wmax;
+  state->wmin = wmin;
+}
+
+void
+perceptron_load(const perceptron_state_t *state)
+{
+  weights = state->weights;
+  bias = state->bias;
+  history = state->history;
+  laneMask = state->laneMask;
+  ringLen = state->ringLen;
+  head = state->head;
+  weightBytes = state->weightBytes;
+  stride = state->stride;
+  histLen = state->histLen;
+  nrows = state->nrows;
+  wbits = state->wbits;
+  threshold = state->threshold;
+  wmax = state->wmax;
+  wmin = state->wmin;
+}
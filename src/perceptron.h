@@ -0,0 +1,70 @@
+//========================================================//
+//  perceptron.h                                          //
+//  Header file for the perceptron predictor              //
+//                                                        //
+//  A table of perceptrons indexed by pc, each weighing   //
+//  the outcomes of the last <hist> branches              //
+//========================================================//
+
+#ifndef PERCEPTRON_H
+#define PERCEPTRON_H
+
+#include <stdint.h>
+
+// Allocate 'rows' perceptrons over 'hist' branches of global history
+// with 'weightBits'-bit saturating weights (at most 32).  Weights are
+// stored in the narrowest of 8, 16 or 32 bits that holds them.  A
+// 'theta' of 0 selects the usual training threshold 1.93*hist + 14
+//
+void perceptron_init(int hist, int rows, int weightBits, int theta);
+
+// Predict the branch at 'pc'.  '*sum' receives the perceptron output,
+// whose magnitude tells how confident the prediction is
+//
+uint8_t perceptron_predict(uint32_t pc, int *sum);
+
+// Train with the real 'outcome' of the branch at 'pc', using the
+// history as it is.  The history does not move
+//
+void perceptron_train(uint32_t pc, uint8_t outcome);
+
+// Shift 'outcome' into the perceptron history
+//
+void perceptron_push(uint8_t outcome);
+
+// Position of the history, to go back to with perceptron_restore.
+// A position stays valid while fewer than updateDelay + MAX_BATCH
+// outcomes are pushed after it
+//
+uint32_t perceptron_history();
+void perceptron_restore(uint32_t position);
+
+// Training threshold in use
+//
+int perceptron_theta();
+
+// Bits of state kept by the perceptron predictor
+//
+uint32_t perceptron_storage_bits();
+
+// Free the weight table
+//
+void perceptron_free();
+
+// The perceptron tables and parameters, so several predictors can
+// take turns (see predictor_context_t)
+//
+typedef struct {
+  void *weights;
+  int32_t *bias;
+  int8_t *history;
+  int8_t *laneMask;
+  int ringLen;
+  uint32_t head;
+  int weightBytes, stride, histLen, nrows, wbits, threshold, wmax, wmin;
+} perceptron_state_t;
+
+void perceptron_save(perceptron_state_t *state);
+void perceptron_load(const perceptron_state_t *state);
+
+#endif
@@ -0,0 +1,157 @@
+//========================================================//
+//  perf.c                                                //
+//  Source file for hardware counter measurement          //
+//                                                        //
+//  Each event is opened on its own so that one the CPU   //
+//  or kernel does not offer leaves the others working.   //
+//  Counts are scaled up when the kernel had to share     //
+//  the hardware counters between events                  //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+#define CACHE_EVENT(cache, op, result) \
+  ((cache) | ((op) << 8) | ((result) << 16))
+
+typedef struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+  uint64_t count;
+} perf_counter_t;
+
+// Indices of the counters IPC is computed from
+#define CYCLES        0
+#define INSTRUCTIONS  1
+
+static perf_counter_t counters[] = {
+  { "Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0 },
+  { "Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0 },
+  { "Branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0 },
+  { "L1D loads", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_ACCESS), -1, 0 },
+  { "L1D misses", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_MISS), -1, 0 },
+  { "LLC loads", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_ACCESS), -1, 0 },
+  { "LLC misses", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_MISS), -1, 0 },
+  { "dTLB loads", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_ACCESS), -1, 0 },
+  { "dTLB misses", PERF_TYPE_HW_CACHE,
+    CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                PERF_COUNT_HW_CACHE_RESULT_MISS), -1, 0 },
+
+  // A software event, still there when the hardware counters are not
+  { "Task clock ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1, 0 },
+};
+#define NCOUNTERS ((int)(sizeof(counters) / sizeof(counters[0])))
+
+static int opened;
+static int lastErrno;
+
+//------------------------------------//
+//          Counter Functions         //
+//------------------------------------//
+
+static int
+open_counter(perf_counter_t *c)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = c->type;
+  attr.config = c->config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int
+perf_start()
+{
+  opened = 0;
+  for (int i = 0; i < NCOUNTERS; i++) {
+    counters[i].count = 0;
+    counters[i].fd = open_counter(&counters[i]);
+    if (counters[i].fd < 0) {
+      lastErrno = errno;
+      continue;
+    }
+    opened++;
+  }
+  for (int i = 0; i < NCOUNTERS; i++) {
+    if (counters[i].fd >= 0) {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  return opened;
+}
+
+void
+perf_stop()
+{
+  for (int i = 0; i < NCOUNTERS; i++) {
+    if (counters[i].fd < 0) {
+      continue;
+    }
+    ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    // value, time enabled, time running
+    uint64_t v[3];
+    if (read(counters[i].fd, v, sizeof(v)) != sizeof(v)) {
+      v[0] = 0;
+    } else if (v[2] > 0 && v[2] < v[1]) {
+      v[0] = (uint64_t)((double)v[0] * v[1] / v[2]);
+    } else if (v[2] == 0) {
+      v[0] = 0;
+    }
+    counters[i].count = v[0];
+    close(counters[i].fd);
+  }
+}
+
+void
+perf_report(uint64_t branches)
+{
+  if (opened == 0) {
+    printf("Hardware counters unavailable: %s%s\n", strerror(lastErrno),
+           (lastErrno == EACCES || lastErrno == EPERM) ?
+           " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+    return;
+  }
+  printf("Counter                 Count  Per 1M branches\n");
+  for (int i = 0; i < NCOUNTERS; i++) {
+    if (counters[i].fd < 0) {
+      printf("%-14s %14s\n", counters[i].name, "n/a");
+      continue;
+    }
+    printf("%-14s %14llu  %15.1f\n", counters[i].name,
+           (unsigned long long)counters[i].count,
+           branches ? counters[i].count * 1e6 / branches : 0);
+  }
+  if (counters[CYCLES].fd >= 0 && counters[INSTRUCTIONS].fd >= 0 &&
+      counters[CYCLES].count > 0) {
+    printf("IPC:                %7.3f\n",
+           (double)counters[INSTRUCTIONS].count / counters[CYCLES].count);
+  }
+}
@@ -0,0 +1,29 @@
+//========================================================//
+//  perf.h                                                //
+//  Header file for hardware counter measurement          //
+//                                                        //
+//  Counts cycles, instructions, branch, cache and TLB    //
+//  misses of the simulator itself with perf_event_open,  //
+//  where the kernel allows it                            //
+//========================================================//
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Open and start the counters for this process
+//
+// Returns the number of counters that could be opened
+//
+int perf_start();
+
+// Stop the counters
+//
+void perf_stop();
+
+// Print each counter per million branches, or why none were counted
+//
+void perf_report(uint64_t branches);
+
+#endif
@@ -6,7 +6,13 @@
 //  described in the README                               //
 //========================================================//
 #include <stdio.h>
+#include <string.h>
 #include "predictor.h"
+#include "alias.h"
+#include "alloc.h"
+#include "hash.h"
+#include "loop.h"
+#include "perceptron.h"
 
 //
 // TODO:Student Information
@@ -20,13 +26,26 @@ const char *email       = "ajgupta@ucsd.edu";
 //------------------------------------//
 
 // Handy Global for use in output routines
-const char *bpName[4] = { "Static", "Gshare",
-                          "Tournament", "Custom" };
+const char *bpName[7] = { "Static", "Gshare",
+                          "Tournament", "Custom",
+                          "Bi-Mode", "Gskew", "Perceptron" };
+const char *confName[NCONF] = { "Low", "Medium", "High" };
+const char *hashName[NHASHES] = { "hist", "xor", "fold",
+                                  "select", "skew", "crc" };
 
 int ghistoryBits; // Number of bits used for Global History
 int lhistoryBits; // Number of bits used for Local History
 int pcIndexBits;  // Number of bits used for PC index
 int bpType;       // Branch Prediction Type
+int indexHash;    // Global table index hash (-1 for scheme default)
+int loopBits;     // log2 of loop predictor entries (0 for none)
+int jrsBits;      // log2 of JRS estimator entries (0 for none)
+int updateDelay;  // Branches between prediction and training
+int globalEntries;// Entries of the global tables (0 for 2^ghistoryBits)
+int percHistory;  // Perceptron history length
+int percRows;     // Number of perceptrons
+int percWeightBits;// Bits per perceptron weight
+int percTheta;    // Perceptron training threshold (0 for default)
 int verbose;
 
 //------------------------------------//
@@ -41,6 +60,7 @@ int verbose;
 // 3rd - Custom - Local + gShare
 
 uint32_t ghist;
+uint32_t gEntries;   // entries in each global table, at most 2^ghistoryBits
 uint32_t gmask;
 uint32_t lmask;
 uint32_t pcmask;
@@ -54,6 +74,55 @@ uint32_t *local_pht;
 uint32_t *global_pht;
 uint32_t *choice_pht;
 
+//bi-mode (choice_pht is indexed by pc)
+uint32_t *taken_pht;
+uint32_t *nottaken_pht;
+
+//gskew
+uint32_t *skew_pht[3];
+
+// Kept as the counters train, for table_stats
+uint64_t movedCounters;  // direction counters off their initial value
+uint64_t globalChoices;  // tournament/custom choosers selecting global
+
+//confidence of the last prediction
+uint8_t confidence;
+
+//chooser and component accuracy (tournament and custom)
+chooser_stats_t chooserStats;
+
+//JRS confidence estimator, resetting counters indexed by pc^ghist
+#define JRS_BITS 4
+#define JRS_MAX  ((1<<JRS_BITS)-1)
+uint8_t *jrs_table;
+uint32_t jrsMask;
+
+//delayed training, branches waiting to update the counters together
+//with the histories they were predicted with and the predictions made
+typedef struct {
+  uint32_t pc;
+  uint32_t ghist;
+  uint32_t lhist;
+  uint32_t phist;           // perceptron history position
+  uint8_t prediction;       // final prediction, judged by JRS
+  uint8_t schemePrediction; // before the loop predictor overrides it
+  uint8_t outcome;
+} inflight_t;
+
+//last prediction made, also kept without delayed training so that
+//training does not have to look it up again
+inflight_t checkpoint;
+
+//histories and predictions of a fetch block
+uint32_t batchGhist;
+uint32_t batchPhist;
+uint32_t batchLhist[MAX_BATCH];
+uint8_t batchPrediction[MAX_BATCH];
+uint8_t batchScheme[MAX_BATCH];
+inflight_t *inflight;
+int inflightHead;
+int inflightCount;
+
 //------------------------------------//
 //        Predictor Functions         //
 //------------------------------------//
@@ -68,6 +137,79 @@ make_mask(uint32_t size)
   }
   return mmask;
 }
+
+// Index into the global tables: hash to ghistoryBits bits, then
+// reduce to gEntries entries with a multiply and a shift rather than
+// a modulo, so table sizes need not be powers of two
+//
+static inline uint32_t
+global_index(uint32_t pc, uint32_t hist)
+{
+  return fast_range(index_hash(indexHash, pc, hist, ghistoryBits),
+                    gEntries, ghistoryBits);
+}
+
+static inline uint32_t
+skew_global_index(int bank, uint32_t pc)
+{
+  return fast_range(skew_index(bank, pc, ghist, ghistoryBits),
+                    gEntries, ghistoryBits);
+}
+
+// Allocate a table of 'size' 2-bit counters set to 'init'
+//
+uint32_t*
+make_counters(int size, uint32_t init)
+{
+  uint32_t *table = (uint32_t*) table_alloc(sizeof(uint32_t)*size);
+  table_fill32(table, size, init);
+  return table;
+}
+
+// Confidence of a prediction read from 'counter' and selected by the
+// chooser 'choice'.  Schemes without a chooser pass the counter
+// itself, so a strong counter is high and a weak one low confidence
+//
+uint8_t
+counter_confidence(uint32_t counter, uint32_t choice)
+{
+  int strong = (counter==SN || counter==ST) + (choice==SN || choice==ST);
+  if(strong==2)
+    return CONF_HIGH;
+  else if(strong==1)
+    return CONF_MED;
+  else
+    return CONF_LOW;
+}
+
+// Move a 2-bit counter towards 'outcome', saturating at SN and ST
+//
+void
+update_counter(uint32_t *counter, uint8_t outcome)
+{
+  if(outcome==TAKEN)
+  {
+    if(*counter<ST)
+      (*counter)++;
+  }
+  else
+  {
+    if(*counter>SN)
+      (*counter)--;
+  }
+}
+
+// Train the direction counter 'counter', which started at 'init',
+// keeping movedCounters up to date
+//
+static inline void
+train_counter(uint32_t *counter, uint32_t init, uint8_t outcome)
+{
+  uint32_t old = *counter;
+  update_counter(counter, outcome);
+  movedCounters += (*counter!=init) - (old!=init);
+}
+
 // Initialize the predictor
 //
 void
@@ -78,7 +220,10 @@ init_predictor()
   //
   int size;
   ghist = 0;
-  if(bpType==CUSTOM)
+  memset(&chooserStats, 0, sizeof(chooserStats));
+  movedCounters = 0;
+  globalChoices = 0;
+  if(bpType==CUSTOM && !ghistoryBits && !lhistoryBits && !pcIndexBits)
   {
     ghistoryBits = 13; // Number of bits used for Global History
     lhistoryBits = 11; // Number of bits used for Local History
@@ -87,91 +232,104 @@ init_predictor()
     //                          + 2^13 x 2  (Choice PHT)
     //                          + 2^11 x 2  (Local PHT)
     //                          + 2^11 x 11 (Local BHT)
-    //                          = 59392 bits < 64000 + 256 bits
+    //                          + 13        (Global history)
+    //                          = 59405 bits < 64000 + 256 bits
+    // (checked by storage_bits() and --budget)
   }
+  if(indexHash<0)
+    indexHash = (bpType==TOURNAMENT) ? HASH_HIST : HASH_XOR;
   gmask = make_mask(ghistoryBits);
+  gEntries = 1<<ghistoryBits;
+  if(globalEntries>0 && globalEntries<gEntries)
+    gEntries = globalEntries;
   lmask = make_mask(lhistoryBits);
   pcmask = make_mask(pcIndexBits);
 
   switch(bpType) {
     case GSHARE:
-      size = 1<<ghistoryBits;
-      gs_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        gs_pht[i] = 1;
-      }
+      size = gEntries;
+      gs_pht = make_counters(size, WN);
+      break;
 
     case TOURNAMENT:
-      // Local BHT
+    case CUSTOM:
+      // Local BHT (histories start at zero, as table_alloc leaves them)
       size = 1<<pcIndexBits;
-      local_bht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        local_bht[i] = 0;
-      }
+      local_bht = (uint32_t*) table_alloc(sizeof(uint32_t)*size);
       // Local PHT
       size = 1<<lhistoryBits;
-      local_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        local_pht[i] = 1;
-      }
+      local_pht = make_counters(size, WN);
       // Global PHT
-      size = 1<<ghistoryBits;
-      global_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        global_pht[i] = 1;
-      }
+      size = gEntries;
+      global_pht = make_counters(size, WN);
 
       // Choice PHT
-      size = 1<<ghistoryBits;
-      choice_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        choice_pht[i] = 2;
-      }
+      size = gEntries;
+      choice_pht = make_counters(size, WT);
+      globalChoices = size;
+      break;
 
-    case CUSTOM:
-      // Local BHT
-      size = 1<<pcIndexBits;
-      local_bht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        local_bht[i] = 0;
-      }
-      // Local PHT
-      size = 1<<lhistoryBits;
-      local_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        local_pht[i] = 1;
-      }
-      // Global PHT
-      size = 1<<ghistoryBits;
-      global_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        global_pht[i] = 1;
-      }
+    case BIMODE:
+      // Direction tables start biased their own way, the choice
+      // table starts weakly selecting the not taken table
+      size = gEntries;
+      taken_pht = make_counters(size, WT);
+      nottaken_pht = make_counters(size, WN);
+      choice_pht = make_counters(size, WN);
+      break;
 
-      // Choice PHT
-      size = 1<<ghistoryBits;
-      choice_pht = (uint32_t*) malloc(sizeof(uint32_t)*size);
-      for(int i=0;i<size;i++)
-      {
-        choice_pht[i] = 2;
-      }
+    case GSKEW:
+      size = gEntries;
+      for(int i=0;i<3;i++)
+        skew_pht[i] = make_counters(size, WN);
+      break;
+
+    case PERCEPTRON:
+      perceptron_init(percHistory, percRows, percWeightBits, percTheta);
+      break;
   }      
-  
+
+  if(loopBits>0)
+    loop_init(loopBits);
+
+  if(updateDelay>0)
+  {
+    inflight = (inflight_t*) malloc(sizeof(inflight_t)*(updateDelay+1));
+    inflightHead = 0;
+    inflightCount = 0;
+  }
+
+  if(jrsBits<0)
+    jrsBits = ghistoryBits < MAX_JRS_BITS ? ghistoryBits : MAX_JRS_BITS;
+  if(jrsBits>MAX_JRS_BITS)
+  {
+    fprintf(stderr,"JRS estimator of 2^%d entries is too large\n", jrsBits);
+    exit(1);
+  }
+  if(jrsBits>0)
+  {
+    // table_alloc exits if the table cannot be allocated
+    jrsMask = make_mask(jrsBits);
+    jrs_table = (uint8_t*) table_alloc((size_t)1<<jrsBits);
+  }
+
+  if(aliasTrack)
+  {
+    if(bpType==GSHARE)
+      alias_init(ALIAS_GSHARE, gEntries);
+    if(bpType==TOURNAMENT || bpType==CUSTOM)
+    {
+      alias_init(ALIAS_GLOBAL, gEntries);
+      alias_init(ALIAS_LOCAL, 1<<lhistoryBits);
+      alias_init(ALIAS_CHOICE, gEntries);
+    }
+  }
 }
 
-// Make a prediction for conditional branch instruction at PC 'pc'
-// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
-// indicates a prediction of not taken
+// Prediction of the configured scheme alone, before any side
+// predictor gets to override it
 //
-uint8_t make_prediction(uint32_t pc)
+uint8_t scheme_prediction(uint32_t pc)
 {
   //
   //TODO: Implement prediction scheme
@@ -180,7 +338,6 @@ uint8_t make_prediction(uint32_t pc)
   uint32_t prediction;
 
   // gshare and custom
-  uint32_t pcbits;
   uint32_t histbits;
   uint32_t index;
   
@@ -190,23 +347,30 @@ uint8_t make_prediction(uint32_t pc)
   uint32_t lhist;
   uint32_t ghistbits;
 
+  //gskew
+  int votes;
+
+  //perceptron
+  int sum;
+
   // Make a prediction based on the bpType
   switch (bpType) {
     case STATIC:
+      confidence = CONF_LOW;
       return TAKEN;
 
     case GSHARE:
-      pcbits = pc & gmask;
       histbits = ghist & gmask;
-      index = histbits ^ pcbits;
+      index = global_index(pc, histbits);
       prediction = gs_pht[index];
+      confidence = counter_confidence(prediction, prediction);
       if(prediction>1)
         return TAKEN;
       else
         return NOTTAKEN;
 
     case TOURNAMENT:
-      ghistbits = gmask & ghist;
+      ghistbits = global_index(pc, ghist);
       choice = choice_pht[ghistbits];
       if(choice<2)
       {
@@ -218,15 +382,15 @@ uint8_t make_prediction(uint32_t pc)
       {
         prediction = global_pht[ghistbits];
       }
+      confidence = counter_confidence(prediction, choice);
       if(prediction>1)
         return TAKEN;
       else
         return NOTTAKEN;
 
     case CUSTOM:
-      pcbits = pc & gmask;
       histbits = ghist & gmask;
-      index = histbits ^ pcbits;
+      index = global_index(pc, histbits);
       choice = choice_pht[index];
       if(choice<2)
       {
@@ -238,35 +402,216 @@ uint8_t make_prediction(uint32_t pc)
       {
         prediction = global_pht[index];
       }
+      confidence = counter_confidence(prediction, choice);
+      if(prediction>1)
+        return TAKEN;
+      else
+        return NOTTAKEN;
+
+    case BIMODE:
+      index = global_index(pc, ghist);
+      choice = choice_pht[fast_range(pc & gmask, gEntries, ghistoryBits)];
+      if(choice>1)
+        prediction = taken_pht[index];
+      else
+        prediction = nottaken_pht[index];
+      confidence = counter_confidence(prediction, choice);
       if(prediction>1)
         return TAKEN;
       else
         return NOTTAKEN;
 
+    case GSKEW:
+      votes = 0;
+      for(int i=0;i<3;i++)
+        votes += skew_pht[i][skew_global_index(i, pc)]>1;
+      confidence = (votes==0 || votes==3) ? CONF_HIGH : CONF_LOW;
+      if(votes>1)
+        return TAKEN;
+      else
+        return NOTTAKEN;
+
+    case PERCEPTRON:
+      prediction = perceptron_predict(pc, &sum);
+      confidence = abs(sum)>perceptron_theta() ? CONF_HIGH :
+                   abs(sum)>perceptron_theta()/2 ? CONF_MED : CONF_LOW;
+      return prediction;
+
     default:
       break;
   }
 
   // If there is not a compatable bpType then return NOTTAKEN
+  confidence = CONF_LOW;
   return NOTTAKEN;
 }
 
-// Train the predictor the last executed branch at PC 'pc' and with
-// outcome 'outcome' (true indicates that the branch was taken, false
-// indicates that the branch was not taken)
+// Prediction of the scheme and any side predictors, made from the
+// current histories without touching them.  '*scheme' receives the
+// prediction of the scheme alone, which training needs
+//
+uint8_t predict_now(uint32_t pc, uint8_t *scheme)
+{
+  uint8_t prediction;
+  uint32_t idx;
+
+  *scheme = scheme_prediction(pc);
+
+  // A confident loop predictor overrides the scheme
+  if(loopBits>0 && loop_predict(pc, &prediction))
+  {
+    confidence = CONF_HIGH;
+    return prediction;
+  }
+  prediction = *scheme;
+
+  // The JRS estimator replaces the scheme's own confidence
+  if(jrsBits>0)
+  {
+    idx = (pc ^ ghist) & jrsMask;
+    confidence = jrs_table[idx]==JRS_MAX ? CONF_HIGH :
+                 jrs_table[idx]>=JRS_MAX/2 ? CONF_MED : CONF_LOW;
+  }
+  return prediction;
+}
+
+// Shift 'outcome' into the global history and, for schemes with
+// local history, into the local history of 'pc'.  The perceptron
+// keeps its own longer history
 //
 void
-train_predictor(uint32_t pc, uint8_t outcome)
+update_history(uint32_t pc, uint8_t outcome)
+{
+  ghist = ghist<<1 | outcome;
+  if(bpType==TOURNAMENT || bpType==CUSTOM)
+    local_bht[pc & pcmask] = ((local_bht[pc & pcmask]<<1) | outcome) & lmask;
+  if(bpType==PERCEPTRON)
+    perceptron_push(outcome);
+}
+
+// Make a prediction for conditional branch instruction at PC 'pc'
+// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
+// indicates a prediction of not taken
+//
+uint8_t make_prediction(uint32_t pc)
+{
+  uint8_t scheme;
+  uint8_t prediction = predict_now(pc, &scheme);
+
+  checkpoint.pc = pc;
+  checkpoint.prediction = prediction;
+  checkpoint.schemePrediction = scheme;
+
+  // With delayed training the histories move on at prediction time;
+  // keep a checkpoint to repair them from if this prediction is wrong
+  if(updateDelay>0)
+  {
+    checkpoint.ghist = ghist;
+    if(bpType==TOURNAMENT || bpType==CUSTOM)
+      checkpoint.lhist = local_bht[pc & pcmask];
+    if(bpType==PERCEPTRON)
+      checkpoint.phist = perceptron_history();
+    update_history(pc, prediction);
+  }
+  return prediction;
+}
+
+// Predict a fetch block with the histories at block start.  The
+// history part of each index is shared by the whole block, so all
+// counter lines are prefetched first and their misses overlap
+//
+void
+predict_batch(const uint32_t *pcs, int n, uint8_t *predictions)
+{
+  uint32_t histbits = ghist & gmask;
+  uint32_t index;
+
+  // Remember the histories the block is predicted with, for train_batch
+  batchGhist = ghist;
+  if(bpType==PERCEPTRON)
+    batchPhist = perceptron_history();
+  if(bpType==TOURNAMENT || bpType==CUSTOM)
+  {
+    for(int i=0;i<n;i++)
+      batchLhist[i] = local_bht[pcs[i] & pcmask];
+  }
+
+  switch(bpType) {
+    case GSHARE:
+      for(int i=0;i<n;i++)
+        __builtin_prefetch(&gs_pht[global_index(pcs[i], histbits)]);
+      break;
+
+    case TOURNAMENT:
+    case CUSTOM:
+      for(int i=0;i<n;i++)
+      {
+        index = global_index(pcs[i], histbits);
+        __builtin_prefetch(&choice_pht[index]);
+        __builtin_prefetch(&global_pht[index]);
+        __builtin_prefetch(&local_bht[pcs[i] & pcmask]);
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  for(int i=0;i<n;i++)
+  {
+    predictions[i] = predict_now(pcs[i], &batchScheme[i]);
+    batchPrediction[i] = predictions[i];
+  }
+}
+
+// Confidence of the last prediction made by make_prediction
+//
+uint8_t
+prediction_confidence()
+{
+  return confidence;
+}
+
+// Count a branch trained by a chooser scheme from the values the
+// training already read
+//
+static inline void
+count_choice(uint32_t choice, uint32_t lpred, uint32_t gpred,
+             uint8_t outcome)
+{
+  uint32_t lright = lpred==outcome;
+  uint32_t gright = gpred==outcome;
+
+  chooserStats.branches++;
+  chooserStats.choseGlobal += choice>1;
+  chooserStats.localCorrect += lright;
+  chooserStats.globalCorrect += gright;
+  chooserStats.chosenCorrect += (choice>1) ? gright : lright;
+  chooserStats.oracleCorrect += lright | gright;
+}
+
+// Chooser counters since init_predictor
+//
+const chooser_stats_t *
+chooser_stats()
+{
+  chooserStats.choseLocal = chooserStats.branches - chooserStats.choseGlobal;
+  return &chooserStats;
+}
+
+// Train the configured scheme alone.  'prediction' is what the scheme
+// predicted for this branch
+//
+void
+train_scheme(uint32_t pc, uint8_t outcome, uint8_t prediction)
 {
   //
   //TODO: Implement Predictor training
   //
 
   // gshare and custom
-  uint32_t pcbits;
   uint32_t histbits;
   uint32_t index;
-  uint8_t prediction = make_prediction(pc);
 
   // tournament and custom
   uint32_t ghistbits;
@@ -279,24 +624,17 @@ train_predictor(uint32_t pc, uint8_t outcome)
   switch(bpType) {
     
     case GSHARE:
-      pcbits = pc & gmask;
       histbits = ghist & gmask;
-      index = histbits ^ pcbits;
-      if(outcome==TAKEN)
-      {
-        if(gs_pht[index]<3)
-          gs_pht[index]++;
-      }
-      else
-      {
-        if(gs_pht[index]>0)
-          gs_pht[index]--;
-      }
+      index = global_index(pc, histbits);
+      if(aliasTrack)
+        alias_access(ALIAS_GSHARE, index, pc, histbits,
+                     (gs_pht[index]>1)==outcome);
+      train_counter(&gs_pht[index], WN, outcome);
       ghist = ghist<<1 | outcome;
       return;
     
     case TOURNAMENT:
-      ghistbits = gmask & ghist;
+      ghistbits = global_index(pc, ghist);
       choice = choice_pht[ghistbits];
       pcidx = pcmask & pc;
       lhist = lmask & local_bht[pcidx];
@@ -313,32 +651,29 @@ train_predictor(uint32_t pc, uint8_t outcome)
       else
         gpred = NOTTAKEN;
 
+      if(aliasTrack)
+      {
+        alias_access(ALIAS_GLOBAL, ghistbits, pc, ghist & gmask,
+                     gpred==outcome);
+        alias_access(ALIAS_LOCAL, lhist, pc, lhist, lpred==outcome);
+        alias_access(ALIAS_CHOICE, ghistbits, pc, ghist & gmask,
+                     ((choice>1) ? gpred : lpred)==outcome);
+      }
+      count_choice(choice, lpred, gpred, outcome);
       if(gpred==outcome && lpred!=outcome && choice_pht[ghistbits]!=3)
         choice_pht[ghistbits]++;
       else if(gpred!=outcome && lpred==outcome && choice_pht[ghistbits]!=0)
         choice_pht[ghistbits]--;
-      if(outcome==TAKEN)
-      {
-        if(global_pht[ghistbits]!=3)
-          global_pht[ghistbits]++;
-        if(local_pht[lhist]!=3)
-          local_pht[lhist]++;
-      }
-      else
-      {
-        if(global_pht[ghistbits]!=0)
-          global_pht[ghistbits]--;
-        if(local_pht[lhist]!=0)
-          local_pht[lhist]--;
-      }
+      globalChoices += (choice_pht[ghistbits]>1) - (choice>1);
+      train_counter(&global_pht[ghistbits], WN, outcome);
+      train_counter(&local_pht[lhist], WN, outcome);
       local_bht[pcidx] = ((local_bht[pcidx]<<1) | outcome) & lmask;
       ghist = ((ghist<<1) | outcome) & gmask;
       return;
 
     case CUSTOM:
-      pcbits = pc & gmask;
       histbits = ghist & gmask;
-      index = histbits ^ pcbits;
+      index = global_index(pc, histbits);
       choice = choice_pht[index];
       pcidx = pcmask & pc;
       lhist = lmask & local_bht[pcidx];
@@ -355,29 +690,396 @@ train_predictor(uint32_t pc, uint8_t outcome)
       else
         gpred = NOTTAKEN;
 
+      if(aliasTrack)
+      {
+        alias_access(ALIAS_GLOBAL, index, pc, histbits, gpred==outcome);
+        alias_access(ALIAS_LOCAL, lhist, pc, lhist, lpred==outcome);
+        alias_access(ALIAS_CHOICE, index, pc, histbits,
+                     ((choice>1) ? gpred : lpred)==outcome);
+      }
+      count_choice(choice, lpred, gpred, outcome);
       if(gpred==outcome && lpred!=outcome && choice_pht[index]!=3)
         choice_pht[index]++;
       else if(gpred!=outcome && lpred==outcome && choice_pht[index]!=0)
         choice_pht[index]--;
-      if(outcome==TAKEN)
-      {
-        if(global_pht[index]!=3)
-          global_pht[index]++;
-        if(local_pht[lhist]!=3)
-          local_pht[lhist]++;
-      }
+      globalChoices += (choice_pht[index]>1) - (choice>1);
+      train_counter(&global_pht[index], WN, outcome);
+      train_counter(&local_pht[lhist], WN, outcome);
+      local_bht[pcidx] = local_bht[pcidx]<<1 | outcome;
+      ghist = ghist<<1 | outcome;
+      return;
+
+    case BIMODE:
+      index = global_index(pc, ghist);
+      pcidx = fast_range(pc & gmask, gEntries, ghistoryBits);
+      choice = choice_pht[pcidx];
+      // Only the selected direction counter learns.  The choice
+      // counter follows the outcome, except when it disagreed with
+      // the outcome but the selected table was still right
+      if(choice>1)
+        train_counter(&taken_pht[index], WT, outcome);
       else
+        train_counter(&nottaken_pht[index], WN, outcome);
+      if(!((choice>1)!=outcome && prediction==outcome))
+        update_counter(&choice_pht[pcidx], outcome);
+      ghist = ((ghist<<1) | outcome) & gmask;
+      return;
+
+    case GSKEW:
+      // Partial update: on a correct prediction only the banks that
+      // voted for the outcome are strengthened, otherwise all learn
+      for(int i=0;i<3;i++)
       {
-        if(global_pht[index]!=0)
-          global_pht[index]--;
-        if(local_pht[lhist]!=0)
-          local_pht[lhist]--;
+        uint32_t *counter = &skew_pht[i][skew_global_index(i, pc)];
+        if(prediction!=outcome || (*counter>1)==outcome)
+          train_counter(counter, WN, outcome);
       }
-      local_bht[pcidx] = local_bht[pcidx]<<1 | outcome;
-      ghist = ghist<<1 | outcome;
+      ghist = ((ghist<<1) | outcome) & gmask;
       return;
 
+    case PERCEPTRON:
+      // The history moves in update_history, or in train_predictor
+      // when training is not delayed
+      perceptron_train(pc, outcome);
+      return;
+
+    default:
+      break;
+  }
+}
+
+// Append a part of the predictor state to 'items'
+//
+void
+add_item(storage_item_t *items, int *n, const char *name, uint32_t bits)
+{
+  if(bits>0 && *n<MAX_STORAGE_ITEMS)
+  {
+    items[*n].name = name;
+    items[*n].bits = bits;
+    (*n)++;
+  }
+}
+
+// Break down the state kept by the configured predictor
+//
+int
+storage_items(storage_item_t *items)
+{
+  uint32_t gsize = gEntries;
+  int n = 0;
+
+  switch(bpType) {
+    case GSHARE:
+      add_item(items, &n, "Global PHT", gsize*2);
+      add_item(items, &n, "Global history", ghistoryBits);
+      break;
+
+    case TOURNAMENT:
+    case CUSTOM:
+      add_item(items, &n, "Global PHT", gsize*2);
+      add_item(items, &n, "Choice PHT", gsize*2);
+      add_item(items, &n, "Local PHT", (1<<lhistoryBits)*2);
+      add_item(items, &n, "Local BHT", (1<<pcIndexBits)*lhistoryBits);
+      add_item(items, &n, "Global history", ghistoryBits);
+      break;
+
+    case BIMODE:
+      add_item(items, &n, "Taken PHT", gsize*2);
+      add_item(items, &n, "Not taken PHT", gsize*2);
+      add_item(items, &n, "Choice PHT", gsize*2);
+      add_item(items, &n, "Global history", ghistoryBits);
+      break;
+
+    case GSKEW:
+      add_item(items, &n, "Skewed PHTs", 3*gsize*2);
+      add_item(items, &n, "Global history", ghistoryBits);
+      break;
+
+    case PERCEPTRON:
+      add_item(items, &n, "Perceptrons", perceptron_storage_bits());
+      break;
+
+    default:
+      break;
+  }
+
+  if(loopBits>0)
+    add_item(items, &n, "Loop predictor", loop_storage_bits());
+  if(jrsBits>0)
+    add_item(items, &n, "JRS estimator", (1<<jrsBits)*JRS_BITS);
+  return n;
+}
+
+// Number of bits of state kept by the configured predictor
+//
+uint32_t
+storage_bits()
+{
+  storage_item_t items[MAX_STORAGE_ITEMS];
+  int n = storage_items(items);
+  uint32_t bits = 0;
+
+  for(int i=0;i<n;i++)
+    bits += items[i].bits;
+  return bits;
+}
+
+// Train the scheme and side predictors right away with the histories
+// as they are.  'prediction' and 'scheme' are the final and the
+// scheme's own prediction of the branch, kept from when it was made
+//
+void
+train_now(uint32_t pc, uint8_t outcome, uint8_t prediction, uint8_t scheme)
+{
+  uint32_t idx;
+
+  // Resetting miss-distance counter: counts correct predictions
+  // since the last miss
+  if(jrsBits>0)
+  {
+    idx = (pc ^ ghist) & jrsMask;
+    if(prediction!=outcome)
+      jrs_table[idx] = 0;
+    else if(jrs_table[idx]<JRS_MAX)
+      jrs_table[idx]++;
+  }
+  if(loopBits>0)
+    loop_train(pc, outcome, scheme==outcome);
+  train_scheme(pc, outcome, scheme);
+}
+
+// Retire the oldest in-flight branch: train with the histories it was
+// predicted with, then put the current speculative histories back
+//
+void
+retire_inflight()
+{
+  inflight_t *e = &inflight[inflightHead];
+  uint32_t pcidx = e->pc & pcmask;
+  int local = (bpType==TOURNAMENT || bpType==CUSTOM);
+  int perc = (bpType==PERCEPTRON);
+  uint32_t liveGhist = ghist;
+  uint32_t liveLhist = local ? local_bht[pcidx] : 0;
+  uint32_t livePhist = perc ? perceptron_history() : 0;
+
+  ghist = e->ghist;
+  if(local)
+    local_bht[pcidx] = e->lhist;
+  if(perc)
+    perceptron_restore(e->phist);
+  train_now(e->pc, e->outcome, e->prediction, e->schemePrediction);
+  ghist = liveGhist;
+  if(local)
+    local_bht[pcidx] = liveLhist;
+  if(perc)
+    perceptron_restore(livePhist);
+
+  inflightHead = (inflightHead+1) % (updateDelay+1);
+  inflightCount--;
+}
+
+// Train the predictor the last executed branch at PC 'pc' and with
+// outcome 'outcome' (true indicates that the branch was taken, false
+// indicates that the branch was not taken)
+//
+void
+train_predictor(uint32_t pc, uint8_t outcome)
+{
+  if(updateDelay<=0)
+  {
+    // Branches trained without being predicted first are looked up
+    if(checkpoint.pc!=pc)
+    {
+      checkpoint.pc = pc;
+      checkpoint.prediction = predict_now(pc, &checkpoint.schemePrediction);
+    }
+    train_now(pc, outcome, checkpoint.prediction,
+              checkpoint.schemePrediction);
+    if(bpType==PERCEPTRON)
+      perceptron_push(outcome);
+    checkpoint.pc = ~pc;
+    return;
+  }
+
+  // Repair the speculative histories on a misprediction
+  if(checkpoint.pc==pc && checkpoint.prediction!=outcome)
+  {
+    ghist = checkpoint.ghist;
+    if(bpType==TOURNAMENT || bpType==CUSTOM)
+      local_bht[pc & pcmask] = checkpoint.lhist;
+    if(bpType==PERCEPTRON)
+      perceptron_restore(checkpoint.phist);
+    update_history(pc, outcome);
+  }
+
+  // Counters only learn once the branch is 'updateDelay' branches old
+  checkpoint.outcome = outcome;
+  inflight[(inflightHead+inflightCount) % (updateDelay+1)] = checkpoint;
+  inflightCount++;
+  if(inflightCount>updateDelay)
+    retire_inflight();
+}
+
+// Retire every branch still in flight
+//
+void
+flush_predictor()
+{
+  while(inflightCount>0)
+    retire_inflight();
+}
+
+// Train the 'n' branches of a block predicted by predict_batch.  Each
+// trains the counters it was predicted from, i.e. with the histories
+// at block start, while the live histories advance branch by branch
+//
+void
+train_batch(const uint32_t *pcs, const uint8_t *outcomes, int n)
+{
+  int local = (bpType==TOURNAMENT || bpType==CUSTOM);
+  int perc = (bpType==PERCEPTRON);
+
+  for(int i=0;i<n;i++)
+  {
+    uint32_t pcidx = pcs[i] & pcmask;
+    uint32_t liveGhist = ghist;
+    uint32_t liveLhist = local ? local_bht[pcidx] : 0;
+    uint32_t livePhist = perc ? perceptron_history() : 0;
+
+    ghist = batchGhist;
+    if(local)
+      local_bht[pcidx] = batchLhist[i];
+    if(perc)
+      perceptron_restore(batchPhist);
+    train_now(pcs[i], outcomes[i], batchPrediction[i], batchScheme[i]);
+    ghist = liveGhist;
+    if(local)
+      local_bht[pcidx] = liveLhist;
+    if(perc)
+      perceptron_restore(livePhist);
+    update_history(pcs[i], outcomes[i]);
+  }
+}
+
+// Measure the tables of the configured scheme from the counts kept
+// by train_scheme
+//
+void
+table_stats(table_stats_t *stats)
+{
+  uint64_t counters = 0;
+
+  stats->occupancy = -1;
+  stats->chooserGlobal = -1;
+  switch(bpType) {
+    case GSHARE:
+      counters = gEntries;
+      break;
+
+    case TOURNAMENT:
+    case CUSTOM:
+      counters = gEntries + (1<<lhistoryBits);
+      stats->chooserGlobal = (double)globalChoices/gEntries;
+      break;
+
+    case BIMODE:
+      counters = 2*(uint64_t)gEntries;
+      break;
+
+    case GSKEW:
+      counters = 3*(uint64_t)gEntries;
+      break;
+
     default:
       break;
   }
+  if(counters>0)
+    stats->occupancy = (double)movedCounters/counters;
+}
+
+// Globals that make up a predictor, listed once for both directions
+// of context_save and context_load
+//
+#define CONTEXT_FIELDS(X) \
+  X(ghistoryBits) X(lhistoryBits) X(pcIndexBits) X(bpType) X(indexHash) \
+  X(loopBits) X(jrsBits) X(updateDelay) X(globalEntries) \
+  X(percHistory) X(percRows) X(percWeightBits) X(percTheta) \
+  X(ghist) X(gEntries) X(gmask) X(lmask) X(pcmask) \
+  X(gs_pht) X(local_bht) X(local_pht) X(global_pht) X(choice_pht) \
+  X(taken_pht) X(nottaken_pht) X(confidence) X(chooserStats) \
+  X(movedCounters) X(globalChoices) \
+  X(jrs_table) X(jrsMask) X(checkpoint) X(batchGhist) X(batchPhist) \
+  X(inflight) X(inflightHead) X(inflightCount)
+
+#define CONTEXT_FIELD(f) __typeof__(f) f;
+
+struct predictor_context {
+  CONTEXT_FIELDS(CONTEXT_FIELD)
+  uint32_t *skew_pht[3];
+  uint32_t batchLhist[MAX_BATCH];
+  uint8_t batchPrediction[MAX_BATCH];
+  uint8_t batchScheme[MAX_BATCH];
+  loop_state_t loop;
+  perceptron_state_t perceptron;
+};
+
+predictor_context_t *
+context_alloc()
+{
+  return (predictor_context_t*) calloc(1, sizeof(predictor_context_t));
+}
+
+void
+context_save(predictor_context_t *ctx)
+{
+#define SAVE_FIELD(f) ctx->f = f;
+  CONTEXT_FIELDS(SAVE_FIELD)
+#undef SAVE_FIELD
+  memcpy(ctx->skew_pht, skew_pht, sizeof(skew_pht));
+  memcpy(ctx->batchLhist, batchLhist, sizeof(batchLhist));
+  memcpy(ctx->batchPrediction, batchPrediction, sizeof(batchPrediction));
+  memcpy(ctx->batchScheme, batchScheme, sizeof(batchScheme));
+  loop_save(&ctx->loop);
+  perceptron_save(&ctx->perceptron);
+}
+
+void
+context_load(const predictor_context_t *ctx)
+{
+#define LOAD_FIELD(f) f = ctx->f;
+  CONTEXT_FIELDS(LOAD_FIELD)
+#undef LOAD_FIELD
+  memcpy(skew_pht, ctx->skew_pht, sizeof(skew_pht));
+  memcpy(batchLhist, ctx->batchLhist, sizeof(batchLhist));
+  memcpy(batchPrediction, ctx->batchPrediction, sizeof(batchPrediction));
+  memcpy(batchScheme, ctx->batchScheme, sizeof(batchScheme));
+  loop_load(&ctx->loop);
+  perceptron_load(&ctx->perceptron);
+}
+
+// Free every table allocated by init_predictor, so the predictor can
+// be initialized again
+//
+void
+free_predictor()
+{
+  table_free(gs_pht);
+  table_free(local_bht);
+  table_free(local_pht);
+  table_free(global_pht);
+  table_free(choice_pht);
+  table_free(taken_pht);
+  table_free(nottaken_pht);
+  for(int i=0;i<3;i++)
+    table_free(skew_pht[i]);
+  table_free(jrs_table);
+  free(inflight);
+  loop_free();
+  perceptron_free();
+  gs_pht = local_bht = local_pht = global_pht = choice_pht = NULL;
+  taken_pht = nottaken_pht = NULL;
+  skew_pht[0] = skew_pht[1] = skew_pht[2] = NULL;
+  jrs_table = NULL;
+  inflight = NULL;
 }
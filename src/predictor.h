@@ -30,6 +30,9 @@ extern const char *email;
 #define GSHARE      1
 #define TOURNAMENT  2
 #define CUSTOM      3
+#define BIMODE      4
+#define GSKEW       5
+#define PERCEPTRON  6
 extern const char *bpName[];
 
 // Definitions for 2-bit counters
@@ -38,6 +41,13 @@ extern const char *bpName[];
 #define WT  2			// predict T, weak taken
 #define ST  3			// predict T, strong taken
 
+// Confidence levels of a prediction
+#define CONF_LOW    0
+#define CONF_MED    1
+#define CONF_HIGH   2
+#define NCONF       3
+extern const char *confName[];
+
 //------------------------------------//
 //      Predictor Configuration       //
 //------------------------------------//
@@ -45,8 +55,24 @@ extern int ghistoryBits; // Number of bits used for Global History
 extern int lhistoryBits; // Number of bits used for Local History
 extern int pcIndexBits;  // Number of bits used for PC index
 extern int bpType;       // Branch Prediction Type
+extern int indexHash;    // Global table index hash (see hash.h)
+extern int loopBits;     // log2 of loop predictor entries (0 for none)
+extern int jrsBits;      // log2 of JRS estimator entries (0 for none)
+extern int updateDelay;  // Branches between prediction and training
+extern int globalEntries;// Entries of the global tables (0 for 2^ghistoryBits)
+extern int percHistory;  // Perceptron history length
+extern int percRows;     // Number of perceptrons
+extern int percWeightBits;// Bits per perceptron weight
+extern int percTheta;    // Perceptron training threshold (0 for default)
 extern int verbose;
 
+// Largest loop predictor and JRS estimator accepted (log2 entries)
+#define MAX_LOOP_BITS 24
+#define MAX_JRS_BITS  24
+
+// Longest update delay accepted (branches)
+#define MAX_DELAY     4096
+
 //------------------------------------//
 //    Predictor Function Prototypes   //
 //------------------------------------//
@@ -61,10 +87,99 @@ void init_predictor();
 //
 uint8_t make_prediction(uint32_t pc);
 
+// Predict the 'n' (at most MAX_BATCH) branches of a fetch block at
+// 'pcs' into 'predictions', all with the histories as they are now.
+// Table accesses for the whole block are issued before any is used
+//
+#define MAX_BATCH 64
+void predict_batch(const uint32_t *pcs, int n, uint8_t *predictions);
+
+// Confidence (CONF_LOW, CONF_MED or CONF_HIGH) of the last prediction
+// returned by make_prediction.  It comes from the counters the
+// prediction already read, or from the JRS estimator if enabled
+//
+uint8_t prediction_confidence();
+
 // Train the predictor the last executed branch at PC 'pc' and with
 // outcome 'outcome' (true indicates that the branch was taken, false
 // indicates that the branch was not taken)
 //
 void train_predictor(uint32_t pc, uint8_t outcome);
 
+// Train the block last predicted by predict_batch with its outcomes
+//
+void train_batch(const uint32_t *pcs, const uint8_t *outcomes, int n);
+
+// Train the branches still waiting out the update delay, as if the
+// trace ended there.  Call before reading the tables or statistics
+//
+void flush_predictor();
+
+// Free the predictor's tables; init_predictor may be called again
+//
+void free_predictor();
+
+// Number of bits of state (tables and history registers) kept by the
+// configured predictor, for comparison against the storage budget
+//
+uint32_t storage_bits();
+
+// State of the predictor tables at some point of a run
+//
+typedef struct {
+  double occupancy;      // Fraction of direction counters moved off
+                         // their initial value (-1 if not tracked)
+  double chooserGlobal;  // Fraction of chooser counters selecting the
+                         // global side (-1 without a chooser)
+} table_stats_t;
+
+// Measure the tables of the configured scheme
+//
+void table_stats(table_stats_t *stats);
+
+// How the chooser of a tournament or custom predictor did, counted as
+// branches are trained
+//
+typedef struct {
+  uint64_t branches;
+  uint64_t choseLocal;     // Chooser selected the local prediction
+  uint64_t choseGlobal;    // Chooser selected the global prediction
+  uint64_t localCorrect;   // Local component was right
+  uint64_t globalCorrect;  // Global component was right
+  uint64_t chosenCorrect;  // The selected component was right
+  uint64_t oracleCorrect;  // Either component was right
+} chooser_stats_t;
+
+// Chooser counters of the configured predictor since init_predictor
+// (all zero for schemes without a chooser)
+//
+const chooser_stats_t *chooser_stats();
+
+// Everything init_predictor sets up, configuration included.  The
+// predictor state is global; saving it to one context and loading
+// another lets several predictors take turns (see bpred.c)
+//
+typedef struct predictor_context predictor_context_t;
+
+// Allocate an empty context.  Loading it leaves no predictor, ready
+// for init_predictor
+//
+predictor_context_t *context_alloc();
+
+void context_save(predictor_context_t *ctx);
+void context_load(const predictor_context_t *ctx);
+
+// One part of the predictor state
+//
+typedef struct {
+  const char *name;
+  uint32_t bits;
+} storage_item_t;
+#define MAX_STORAGE_ITEMS 12
+
+// Break the state counted by storage_bits down into 'items' (room for
+// MAX_STORAGE_ITEMS).  Returns the number of items filled in
+//
+int storage_items(storage_item_t *items);
+
 #endif
@@ -0,0 +1,567 @@
+//========================================================//
+//  trace.c                                               //
+//  Source file for trace input                           //
+//                                                        //
+//  Streams trace files and keeps decoded traces in a     //
+//  file-backed shared mapping so that repeated runs      //
+//  over the same trace do not decompress it again.       //
+//  Packed traces trade that mapping for a dictionary of  //
+//  PCs and an outcome bitstream                          //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "trace.h"
+
+// Layout of a cache entry:
+//   trace_header_t
+//   uint32_t pc[count]
+//   uint8_t  outcome[count]
+//
+#define TRACE_MAGIC "BPTRACE1"
+
+typedef struct {
+  char magic[8];
+  uint64_t count;
+  uint64_t hash;
+} trace_header_t;
+
+//------------------------------------//
+//          Stream Functions          //
+//------------------------------------//
+
+static int
+has_suffix(const char *s, const char *suffix)
+{
+  size_t n = strlen(s);
+  size_t m = strlen(suffix);
+  return n >= m && !strcmp(s + n - m, suffix);
+}
+
+FILE *
+trace_open_stream(const char *path, pid_t *decoder)
+{
+  *decoder = 0;
+  if (!has_suffix(path, ".bz2")) {
+    return fopen(path, "r");
+  }
+
+  // Decompress through bunzip2 so we need no extra libraries
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return NULL;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return NULL;
+  }
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execlp("bunzip2", "bunzip2", "-kc", path, (char *)NULL);
+    _exit(127);
+  }
+  close(fds[1]);
+  *decoder = pid;
+  return fdopen(fds[0], "r");
+}
+
+void
+trace_close_stream(FILE *stream, pid_t decoder)
+{
+  if (stream != NULL && stream != stdin) {
+    fclose(stream);
+  }
+  if (decoder > 0) {
+    waitpid(decoder, NULL, 0);
+  }
+}
+
+//------------------------------------//
+//        Mapped Text Functions       //
+//------------------------------------//
+
+int
+trace_map_text(const char *path, trace_text_t *text)
+{
+  if (has_suffix(path, ".bz2")) {
+    return 0;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+
+  // The file is read once front to back; ask for aggressive
+  // read-ahead and, where the kernel supports it, huge pages
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+
+  text->data = map;
+  text->len = st.st_size;
+  text->pos = 0;
+  return 1;
+}
+
+int
+trace_next_text(trace_text_t *text, uint32_t *pc, uint8_t *outcome)
+{
+  const char *p = text->data + text->pos;
+  const char *end = text->data + text->len;
+
+  while (p < end) {
+    const char *line = p;
+    const char *eol = memchr(p, '\n', end - p);
+    eol = eol ? eol : end;
+    p = eol + 1;
+
+    // Same lines as sscanf("0x%x %u") accepts; anything else is skipped
+    if (eol - line < 4 || line[0] != '0' || (line[1] | 0x20) != 'x') {
+      continue;
+    }
+    const char *c = line + 2;
+    uint32_t v = 0;
+    int digits = 0;
+    for (; c < eol; c++, digits++) {
+      int d = *c;
+      if (d >= '0' && d <= '9') {
+        d -= '0';
+      } else if ((d | 0x20) >= 'a' && (d | 0x20) <= 'f') {
+        d = (d | 0x20) - 'a' + 10;
+      } else {
+        break;
+      }
+      v = (v << 4) | d;
+    }
+    while (c < eol && (*c == ' ' || *c == '\t')) {
+      c++;
+    }
+    if (digits == 0 || c == eol || *c < '0' || *c > '9') {
+      continue;
+    }
+    uint32_t o = 0;
+    for (; c < eol && *c >= '0' && *c <= '9'; c++) {
+      o = o * 10 + (*c - '0');
+    }
+
+    text->pos = (p < end ? p : end) - text->data;
+    *pc = v;
+    *outcome = o;
+    return 1;
+  }
+  text->pos = text->len;
+  return 0;
+}
+
+void
+trace_unmap_text(trace_text_t *text)
+{
+  if (text->data != NULL) {
+    munmap((void *)text->data, text->len);
+  }
+  memset(text, 0, sizeof(*text));
+}
+
+//------------------------------------//
+//           Cache Functions          //
+//------------------------------------//
+
+// FNV-1a over the raw trace file, so a changed trace gets a new entry
+//
+static int
+hash_file(const char *path, uint64_t *hash)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return 0;
+  }
+  unsigned char chunk[1 << 16];
+  uint64_t h = 14695981039346656037ULL;
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      h = (h ^ chunk[i]) * 1099511628211ULL;
+    }
+  }
+  fclose(f);
+  *hash = h;
+  return 1;
+}
+
+// Map a cache entry read-only and check that it is complete
+//
+static int
+map_entry(const char *name, uint64_t hash, trace_t *trace)
+{
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(trace_header_t)) {
+    close(fd);
+    return 0;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+
+  const trace_header_t *hdr = map;
+  if (memcmp(hdr->magic, TRACE_MAGIC, 8) || hdr->hash != hash ||
+      (uint64_t)st.st_size != sizeof(*hdr) + hdr->count * 5) {
+    munmap(map, st.st_size);
+    return 0;
+  }
+
+  trace->count = hdr->count;
+  trace->pc = (const uint32_t *)(hdr + 1);
+  trace->outcome = (const uint8_t *)(trace->pc + hdr->count);
+  trace->map = map;
+  trace->mapLen = st.st_size;
+  return 1;
+}
+
+// Parse every branch of a text trace into growing arrays
+//
+// Returns True if Successful
+//
+static int
+decode_stream(FILE *stream, uint32_t **pcsOut, uint8_t **outcomesOut,
+              uint64_t *countOut)
+{
+  uint64_t count = 0, cap = 1 << 20;
+  uint32_t *pcs = malloc(cap * sizeof(uint32_t));
+  uint8_t *outcomes = malloc(cap);
+  char *line = NULL;
+  size_t len = 0;
+  int ok = pcs != NULL && outcomes != NULL;
+  while (ok && getline(&line, &len, stream) != -1) {
+    uint32_t pc, tmp;
+    if (sscanf(line, "0x%x %u", &pc, &tmp) != 2) {
+      continue;
+    }
+    if (count == cap) {
+      uint32_t *morePcs = realloc(pcs, 2 * cap * sizeof(uint32_t));
+      pcs = morePcs ? morePcs : pcs;
+      uint8_t *moreOutcomes = realloc(outcomes, 2 * cap);
+      outcomes = moreOutcomes ? moreOutcomes : outcomes;
+      ok = morePcs != NULL && moreOutcomes != NULL;
+      cap *= 2;
+      if (!ok) {
+        break;
+      }
+    }
+    pcs[count] = pc;
+    outcomes[count] = tmp;
+    count++;
+  }
+  free(line);
+  if (!ok) {
+    free(pcs);
+    free(outcomes);
+    return 0;
+  }
+  *pcsOut = pcs;
+  *outcomesOut = outcomes;
+  *countOut = count;
+  return 1;
+}
+
+// Decode the trace at 'path' and publish it as cache entry 'name'.
+// The entry is written under a private name and renamed into place,
+// so concurrent first runs never see a partial entry
+//
+static int
+build_entry(const char *path, const char *name, uint64_t hash)
+{
+  pid_t decoder;
+  FILE *stream = trace_open_stream(path, &decoder);
+  if (stream == NULL) {
+    return 0;
+  }
+
+  uint32_t *pcs = NULL;
+  uint8_t *outcomes = NULL;
+  uint64_t count = 0;
+  int decoded = decode_stream(stream, &pcs, &outcomes, &count);
+  trace_close_stream(stream, decoder);
+  if (!decoded) {
+    return 0;
+  }
+
+  int ok = 0;
+  char tmpName[4096];
+  snprintf(tmpName, sizeof(tmpName), "%s.%d", name, (int)getpid());
+  FILE *out = fopen(tmpName, "wb");
+  if (out != NULL) {
+    trace_header_t hdr;
+    memcpy(hdr.magic, TRACE_MAGIC, 8);
+    hdr.count = count;
+    hdr.hash = hash;
+    ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+         fwrite(pcs, sizeof(uint32_t), count, out) == count &&
+         fwrite(outcomes, 1, count, out) == count;
+    ok = (fclose(out) == 0) && ok;
+    chmod(tmpName, 0444);
+    ok = ok && rename(tmpName, name) == 0;
+    if (!ok) {
+      unlink(tmpName);
+    }
+  }
+  free(pcs);
+  free(outcomes);
+  return ok;
+}
+
+int
+trace_attach_cached(const char *path, const char *cacheDir, trace_t *trace)
+{
+  uint64_t hash;
+  if (!hash_file(path, &hash)) {
+    return 0;
+  }
+
+  char name[4096];
+  snprintf(name, sizeof(name), "%s/bp-trace-%016llx",
+           cacheDir, (unsigned long long)hash);
+  if (map_entry(name, hash, trace)) {
+    return 1;
+  }
+  return build_entry(path, name, hash) && map_entry(name, hash, trace);
+}
+
+int
+trace_read_all(FILE *stream, trace_t *trace)
+{
+  uint32_t *pcs;
+  uint8_t *outcomes;
+  uint64_t count;
+  if (!decode_stream(stream, &pcs, &outcomes, &count)) {
+    return 0;
+  }
+  memset(trace, 0, sizeof(*trace));
+  trace->count = count;
+  trace->pc = pcs;
+  trace->outcome = outcomes;
+  return 1;
+}
+
+void
+trace_detach(trace_t *trace)
+{
+  if (trace->map != NULL) {
+    munmap(trace->map, trace->mapLen);
+  } else {
+    free((void *)trace->pc);
+    free((void *)trace->outcome);
+  }
+  memset(trace, 0, sizeof(*trace));
+}
+
+//------------------------------------//
+//          Packing Functions         //
+//------------------------------------//
+
+// Open addressed map from PC to its index in the distinct PC table.
+// Slots hold index + 1, so 0 marks an empty slot
+//
+typedef struct {
+  uint32_t *slots;
+  uint32_t mask;
+} pc_map_t;
+
+static inline uint32_t
+pc_slot(const pc_map_t *map, const uint32_t *pcs, uint32_t pc)
+{
+  uint32_t s = (pc * 2654435761u) & map->mask;
+  while (map->slots[s] != 0 && pcs[map->slots[s] - 1] != pc) {
+    s = (s + 1) & map->mask;
+  }
+  return s;
+}
+
+// Rebuild 'map' with twice the slots
+//
+static int
+pc_map_grow(pc_map_t *map, const uint32_t *pcs, uint32_t npcs)
+{
+  pc_map_t bigger = { NULL, map->mask * 2 + 1 };
+  bigger.slots = calloc((size_t)bigger.mask + 1, sizeof(uint32_t));
+  if (bigger.slots == NULL) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < npcs; i++) {
+    bigger.slots[pc_slot(&bigger, pcs, pcs[i])] = i + 1;
+  }
+  free(map->slots);
+  *map = bigger;
+  return 1;
+}
+
+int
+trace_pack(const trace_t *trace, uint64_t count, trace_packed_t *packed)
+{
+  if (count > trace->count) {
+    count = trace->count;
+  }
+  memset(packed, 0, sizeof(*packed));
+
+  // First pass: the distinct PCs, which decide the index width
+  uint32_t cap = 1 << 10;
+  uint32_t npcs = 0;
+  uint32_t *pcs = malloc(cap * sizeof(uint32_t));
+  pc_map_t map = { calloc(2 * cap, sizeof(uint32_t)), 2 * cap - 1 };
+  int ok = pcs != NULL && map.slots != NULL;
+  for (uint64_t i = 0; ok && i < count; i++) {
+    uint32_t s = pc_slot(&map, pcs, trace->pc[i]);
+    if (map.slots[s] != 0) {
+      continue;
+    }
+    if (npcs == cap) {
+      uint32_t *more = realloc(pcs, 2 * cap * sizeof(uint32_t));
+      ok = more != NULL;
+      pcs = more ? more : pcs;
+      cap *= 2;
+    }
+    if (ok) {
+      pcs[npcs] = trace->pc[i];
+      map.slots[s] = ++npcs;
+    }
+    // Keep the map at most half full
+    if (ok && 2 * npcs > map.mask) {
+      ok = pc_map_grow(&map, pcs, npcs);
+    }
+  }
+
+  int width = npcs <= 1u << 8 ? 1 : npcs <= 1u << 16 ? 2 : 4;
+  void *index = ok ? malloc(count ? count * width : 1) : NULL;
+  uint64_t *outcomes = ok ? calloc((count + 63) / 64 + 1, 8) : NULL;
+  if (index == NULL || outcomes == NULL) {
+    free(pcs);
+    free(map.slots);
+    free(index);
+    free(outcomes);
+    return 0;
+  }
+
+  // Second pass: the index and outcome bit of every branch
+  for (uint64_t i = 0; i < count; i++) {
+    uint32_t idx = map.slots[pc_slot(&map, pcs, trace->pc[i])] - 1;
+    if (width == 1) {
+      ((uint8_t *)index)[i] = idx;
+    } else if (width == 2) {
+      ((uint16_t *)index)[i] = idx;
+    } else {
+      ((uint32_t *)index)[i] = idx;
+    }
+    outcomes[i / 64] |= (uint64_t)(trace->outcome[i] != 0) << (i % 64);
+  }
+  free(map.slots);
+
+  packed->count = count;
+  packed->npcs = npcs;
+  packed->indexBytes = width;
+  packed->pcs = realloc(pcs, (npcs ? npcs : 1) * sizeof(uint32_t));
+  packed->pcs = packed->pcs ? packed->pcs : pcs;
+  packed->index = index;
+  packed->outcomes = outcomes;
+  return 1;
+}
+
+int
+trace_unpack(const trace_packed_t *packed, uint64_t start,
+             uint32_t *pcs, uint8_t *outcomes)
+{
+  if (start >= packed->count) {
+    return 0;
+  }
+  int n = packed->count - start < TRACE_BLOCK ?
+          (int)(packed->count - start) : TRACE_BLOCK;
+
+  // PCs: one table lookup per branch, the loop picked once per block
+  const uint32_t *table = packed->pcs;
+  if (packed->indexBytes == 1) {
+    const uint8_t *idx = (const uint8_t *)packed->index + start;
+    for (int i = 0; i < n; i++) {
+      pcs[i] = table[idx[i]];
+    }
+  } else if (packed->indexBytes == 2) {
+    const uint16_t *idx = (const uint16_t *)packed->index + start;
+    for (int i = 0; i < n; i++) {
+      pcs[i] = table[idx[i]];
+    }
+  } else {
+    const uint32_t *idx = (const uint32_t *)packed->index + start;
+    for (int i = 0; i < n; i++) {
+      pcs[i] = table[idx[i]];
+    }
+  }
+
+  // Outcomes: spread each byte of the block's word over 8 lanes and
+  // test each lane's bit, 16 outcomes per step.  Bits past the end of
+  // the trace are zero and the caller only reads 'n' of them
+  uint64_t word = packed->outcomes[start / 64];
+#ifdef __SSE2__
+  const __m128i bit = _mm_set1_epi64x((long long)0x8040201008040201ULL);
+  const __m128i one = _mm_set1_epi8(1);
+  uint8_t spread[TRACE_BLOCK];
+  for (int k = 0; k < TRACE_BLOCK / 16; k++) {
+    uint64_t lo = (word >> (16 * k)) & 0xff;
+    uint64_t hi = (word >> (16 * k + 8)) & 0xff;
+    __m128i v = _mm_set_epi64x((long long)(hi * 0x0101010101010101ULL),
+                               (long long)(lo * 0x0101010101010101ULL));
+    v = _mm_cmpeq_epi8(_mm_and_si128(v, bit), bit);
+    _mm_storeu_si128((__m128i *)(spread + 16 * k), _mm_and_si128(v, one));
+  }
+  memcpy(outcomes, spread, n);
+#else
+  for (int i = 0; i < n; i++) {
+    outcomes[i] = (word >> i) & 1;
+  }
+#endif
+  return n;
+}
+
+size_t
+trace_packed_bytes(const trace_packed_t *packed)
+{
+  return packed->npcs * sizeof(uint32_t) +
+         packed->count * packed->indexBytes +
+         ((packed->count + 63) / 64 + 1) * sizeof(uint64_t);
+}
+
+void
+trace_free_packed(trace_packed_t *packed)
+{
+  free(packed->pcs);
+  free(packed->index);
+  free(packed->outcomes);
+  memset(packed, 0, sizeof(*packed));
+}
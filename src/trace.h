@@ -0,0 +1,127 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for trace input                           //
+//                                                        //
+//  Opens trace files (plain or bzip2 compressed),        //
+//  manages the shared decoded-trace cache and packs      //
+//  decoded traces compactly for holding many in memory   //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// A fully decoded trace, mapped read-only from the cache or read
+// into memory.  Branch 'i' is at pc[i] with outcome outcome[i].
+//
+typedef struct {
+  uint64_t count;
+  const uint32_t *pc;
+  const uint8_t *outcome;
+  void *map;          // Base of the mapping (NULL if in memory)
+  size_t mapLen;
+} trace_t;
+
+// An uncompressed text trace mapped read-only and parsed in place
+//
+typedef struct {
+  const char *data;
+  size_t len;
+  size_t pos;         // Offset of the next line
+} trace_text_t;
+
+// A decoded trace packed to about 1-2 bytes per branch.  Each branch
+// keeps only an index into the table of distinct PCs, in the
+// narrowest of 1, 2 or 4 bytes that fits, and its outcome as one bit
+// of a bitstream.  Read it back TRACE_BLOCK branches at a time with
+// trace_unpack
+//
+#define TRACE_BLOCK 64
+
+typedef struct {
+  uint64_t count;
+  uint32_t npcs;      // Distinct PCs
+  int indexBytes;     // Width of each entry of 'index'
+  uint32_t *pcs;      // Distinct PCs in order of first appearance
+  void *index;        // Per-branch index into 'pcs'
+  uint64_t *outcomes; // Branch 'i' is bit i%64 of word i/64
+} trace_packed_t;
+
+// Open a trace file as a text stream.  Files ending in '.bz2' are
+// decompressed through bunzip2, in which case '*decoder' is set to
+// the child pid (otherwise 0)
+//
+// Returns NULL on failure
+//
+FILE *trace_open_stream(const char *path, pid_t *decoder);
+
+// Close a stream returned by trace_open_stream
+//
+void trace_close_stream(FILE *stream, pid_t decoder);
+
+// Map the uncompressed text trace at 'path' for sequential parsing
+// with trace_next_text.  Fails for compressed or unmappable files
+// (pipes, empty files), which need trace_open_stream
+//
+// Returns True if Successful
+//
+int trace_map_text(const char *path, trace_text_t *text);
+
+// Parse the next "0x<pc> <outcome>" line of a mapped trace
+//
+// Returns True if a branch was read, False at the end of the trace
+//
+int trace_next_text(trace_text_t *text, uint32_t *pc, uint8_t *outcome);
+
+// Unmap a trace mapped by trace_map_text
+//
+void trace_unmap_text(trace_text_t *text);
+
+// Attach to the cached decoded form of the trace at 'path', decoding
+// it into 'cacheDir' first if no run has cached it yet.  The cache
+// entry is keyed by a hash of the trace file contents, so any number
+// of processes share one read-only copy
+//
+// Returns True if Successful
+//
+int trace_attach_cached(const char *path, const char *cacheDir,
+                        trace_t *trace);
+
+// Read the rest of 'stream' into memory, for runs that need to go
+// over a trace more than once
+//
+// Returns True if Successful
+//
+int trace_read_all(FILE *stream, trace_t *trace);
+
+// Release a trace from trace_attach_cached or trace_read_all
+//
+void trace_detach(trace_t *trace);
+
+// Pack the first 'count' branches of 'trace' (at most its length).
+// Nonzero outcomes pack as taken
+//
+// Returns True if Successful
+//
+int trace_pack(const trace_t *trace, uint64_t count, trace_packed_t *packed);
+
+// Decode the block of up to TRACE_BLOCK branches starting at branch
+// 'start' (a multiple of TRACE_BLOCK) into 'pcs' and 'outcomes'
+//
+// Returns the number of branches decoded, 0 past the end
+//
+int trace_unpack(const trace_packed_t *packed, uint64_t start,
+                 uint32_t *pcs, uint8_t *outcomes);
+
+// Bytes of memory held by a packed trace
+//
+size_t trace_packed_bytes(const trace_packed_t *packed);
+
+// Free a trace from trace_pack
+//
+void trace_free_packed(trace_packed_t *packed);
+
+#endif
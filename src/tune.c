@@ -0,0 +1,536 @@
+//========================================================//
+//  tune.c                                                //
+//  Parameter autotuner for the branch predictors         //
+//                                                        //
+//  Searches history and table sizes of every scheme      //
+//  under a storage budget.  Candidates are simulated in  //
+//  parallel worker processes over a packed in-memory     //
+//  sample of the traces, results are cached on disk by   //
+//  configuration, and the Pareto front of misprediction  //
+//  rate vs. storage vs. simulation speed is printed      //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "predictor.h"
+#include "trace.h"
+
+#define MAX_TRACES     16
+#define MAX_CANDIDATES 4096
+#define MAX_JOBS       64
+
+// A point in the search space
+typedef struct {
+  int type;
+  int g, l, p;
+  int hist, rows, wbits, theta;   // perceptron only
+} config_t;
+
+typedef struct {
+  config_t config;
+  uint32_t storage;
+  int feasible;
+  double rate;       // Mean misprediction rate over the traces
+  double ns;         // Simulation time per branch
+} result_t;
+
+static trace_packed_t traces[MAX_TRACES];
+static int ntraces;
+static uint64_t sample = 1000000;
+static uint32_t budget = 64*1024 + 256;
+static int jobs;
+static int generations = 8;
+static const char *cacheFile = "tune.cache";
+static uint64_t signature;   // Hash of the sampled branches
+
+static result_t results[MAX_CANDIDATES];
+static int nresults;
+
+//------------------------------------//
+//         Search Space Helpers       //
+//------------------------------------//
+
+static const int schemes[] = { GSHARE, TOURNAMENT, CUSTOM, BIMODE, GSKEW,
+                               PERCEPTRON };
+#define NSCHEMES ((int)(sizeof(schemes)/sizeof(schemes[0])))
+
+static void
+config_name(const config_t *c, char *buf, size_t len)
+{
+  switch (c->type) {
+    case TOURNAMENT:
+      snprintf(buf, len, "tournament:%d:%d:%d", c->g, c->l, c->p);
+      break;
+    case CUSTOM:
+      snprintf(buf, len, "custom:%d:%d:%d", c->g, c->l, c->p);
+      break;
+    case BIMODE:
+      snprintf(buf, len, "bimode:%d", c->g);
+      break;
+    case GSKEW:
+      snprintf(buf, len, "gskew:%d", c->g);
+      break;
+    case PERCEPTRON:
+      snprintf(buf, len, "perceptron:%d:%d:%d:%d", c->hist, c->rows,
+               c->wbits, c->theta);
+      break;
+    default:
+      snprintf(buf, len, "gshare:%d", c->g);
+      break;
+  }
+}
+
+static int
+uses_local(int type)
+{
+  return type == TOURNAMENT || type == CUSTOM;
+}
+
+// Load a configuration into the predictor globals
+//
+static void
+configure(const config_t *c)
+{
+  bpType = c->type;
+  ghistoryBits = c->g;
+  lhistoryBits = uses_local(c->type) ? c->l : 0;
+  pcIndexBits = uses_local(c->type) ? c->p : 0;
+  indexHash = -1;
+  globalEntries = 0;
+  jrsBits = 0;
+  loopBits = 0;
+  updateDelay = 0;
+  percHistory = c->hist;
+  percRows = c->rows;
+  percWeightBits = c->wbits;
+  percTheta = c->theta;
+}
+
+static uint32_t
+config_storage(const config_t *c)
+{
+  configure(c);
+  init_predictor();
+  uint32_t bits = storage_bits();
+  free_predictor();
+  return bits;
+}
+
+static int
+clamp(int v, int lo, int hi)
+{
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+static config_t
+random_config()
+{
+  config_t c;
+  memset(&c, 0, sizeof(c));
+  c.type = schemes[rand() % NSCHEMES];
+  if (c.type == PERCEPTRON) {
+    // Around the usual threshold for the history length
+    c.hist = 4 + rand() % 60;
+    c.rows = 1 << (4 + rand() % 7);
+    c.wbits = 5 + rand() % 4;
+    c.theta = clamp((int)(1.93 * c.hist + 14) + rand() % 33 - 16, 1, 255);
+    return c;
+  }
+  c.g = 4 + rand() % 14;
+  c.l = 4 + rand() % 12;
+  c.p = 4 + rand() % 12;
+  return c;
+}
+
+// Move one or two parameters a small step
+//
+static config_t
+mutate(config_t c)
+{
+  int steps = 1 + rand() % 2;
+  for (int i = 0; i < steps; i++) {
+    int delta = (rand() % 2) ? 1 : -1;
+    if (c.type == PERCEPTRON) {
+      switch (rand() % 4) {
+        case 0: c.hist = clamp(c.hist + 4 * delta, 1, 128); break;
+        case 1: c.rows = delta > 0 ? (c.rows < 1 << 16 ? c.rows * 2 : c.rows) :
+                         (c.rows > 1 ? c.rows / 2 : 1); break;
+        case 2: c.wbits = clamp(c.wbits + delta, 2, 16); break;
+        case 3: c.theta = clamp(c.theta + 4 * delta, 1, 255); break;
+      }
+      continue;
+    }
+    switch (uses_local(c.type) ? rand() % 3 : 0) {
+      case 0: c.g = clamp(c.g + delta, 1, 24); break;
+      case 1: c.l = clamp(c.l + delta, 1, 20); break;
+      case 2: c.p = clamp(c.p + delta, 1, 20); break;
+    }
+  }
+  return c;
+}
+
+static result_t *
+find_result(const config_t *c)
+{
+  for (int i = 0; i < nresults; i++) {
+    config_t *o = &results[i].config;
+    if (o->type == c->type && o->g == c->g &&
+        (!uses_local(c->type) || (o->l == c->l && o->p == c->p)) &&
+        (c->type != PERCEPTRON ||
+         (o->hist == c->hist && o->rows == c->rows &&
+          o->wbits == c->wbits && o->theta == c->theta))) {
+      return &results[i];
+    }
+  }
+  return NULL;
+}
+
+//------------------------------------//
+//            Result Cache            //
+//------------------------------------//
+
+static void
+load_cache()
+{
+  FILE *f = fopen(cacheFile, "r");
+  if (f == NULL) {
+    return;
+  }
+  unsigned long long sig;
+  char name[64];
+  result_t r;
+  while (nresults < MAX_CANDIDATES &&
+         fscanf(f, "%llx %63s %u %d %lf %lf", &sig, name, &r.storage,
+                &r.feasible, &r.rate, &r.ns) == 6) {
+    if (sig != signature) {
+      continue;
+    }
+    memset(&r.config, 0, sizeof(r.config));
+    if (sscanf(name, "tournament:%d:%d:%d", &r.config.g, &r.config.l,
+               &r.config.p) == 3) {
+      r.config.type = TOURNAMENT;
+    } else if (sscanf(name, "custom:%d:%d:%d", &r.config.g, &r.config.l,
+                      &r.config.p) == 3) {
+      r.config.type = CUSTOM;
+    } else if (sscanf(name, "bimode:%d", &r.config.g) == 1) {
+      r.config.type = BIMODE;
+    } else if (sscanf(name, "gskew:%d", &r.config.g) == 1) {
+      r.config.type = GSKEW;
+    } else if (sscanf(name, "perceptron:%d:%d:%d:%d", &r.config.hist,
+                      &r.config.rows, &r.config.wbits,
+                      &r.config.theta) == 4) {
+      r.config.type = PERCEPTRON;
+    } else if (sscanf(name, "gshare:%d", &r.config.g) == 1) {
+      r.config.type = GSHARE;
+    } else {
+      continue;
+    }
+    if (find_result(&r.config) == NULL) {
+      results[nresults++] = r;
+    }
+  }
+  fclose(f);
+}
+
+static void
+append_cache(const result_t *r)
+{
+  FILE *f = fopen(cacheFile, "a");
+  if (f == NULL) {
+    return;
+  }
+  char name[64];
+  config_name(&r->config, name, sizeof(name));
+  fprintf(f, "%016llx %s %u %d %.6f %.3f\n", (unsigned long long)signature,
+          name, r->storage, r->feasible, r->rate, r->ns);
+  fclose(f);
+}
+
+//------------------------------------//
+//             Evaluation             //
+//------------------------------------//
+
+// Simulate one configuration over every trace sample, each with a
+// freshly initialized predictor as a separate run of main.c would
+//
+static void
+evaluate(result_t *r)
+{
+  double rateSum = 0;
+  uint64_t branches = 0;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int t = 0; t < ntraces; t++) {
+    uint64_t n = traces[t].count;
+    uint64_t misses = 0;
+    uint32_t pcs[TRACE_BLOCK];
+    uint8_t outcomes[TRACE_BLOCK];
+    int len;
+    configure(&r->config);
+    init_predictor();
+    for (uint64_t i = 0; (len = trace_unpack(&traces[t], i, pcs, outcomes));
+         i += len) {
+      for (int j = 0; j < len; j++) {
+        misses += make_prediction(pcs[j]) != outcomes[j];
+        train_predictor(pcs[j], outcomes[j]);
+      }
+    }
+    free_predictor();
+    rateSum += n ? 100.0 * misses / n : 0;
+    branches += n;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  r->rate = rateSum / ntraces;
+  r->ns = ((end.tv_sec - start.tv_sec) * 1e9 +
+           (end.tv_nsec - start.tv_nsec)) / (branches ? branches : 1);
+}
+
+// Evaluate 'n' candidates, at most 'jobs' worker processes at a time.
+// Workers inherit the trace samples copy-on-write and send their
+// result back through a pipe
+//
+static void
+evaluate_parallel(result_t *batch, int n)
+{
+  pid_t pids[MAX_JOBS];
+  int fds[MAX_JOBS];
+  int slot[MAX_JOBS];
+  int running = 0, next = 0;
+
+  while (next < n || running > 0) {
+    while (next < n && running < jobs) {
+      int p[2];
+      if (pipe(p) != 0) {
+        perror("pipe");
+        exit(1);
+      }
+      pid_t pid = fork();
+      if (pid == 0) {
+        close(p[0]);
+        evaluate(&batch[next]);
+        if (write(p[1], &batch[next], sizeof(result_t)) != sizeof(result_t)) {
+          _exit(1);
+        }
+        _exit(0);
+      }
+      close(p[1]);
+      pids[running] = pid;
+      fds[running] = p[0];
+      slot[running] = next++;
+      running++;
+    }
+
+    int status;
+    pid_t done = wait(&status);
+    for (int j = 0; j < running; j++) {
+      if (pids[j] != done) {
+        continue;
+      }
+      result_t *r = &batch[slot[j]];
+      if (read(fds[j], r, sizeof(result_t)) != sizeof(result_t)) {
+        r->feasible = 0;
+      }
+      close(fds[j]);
+      pids[j] = pids[running-1];
+      fds[j] = fds[running-1];
+      slot[j] = slot[running-1];
+      running--;
+      break;
+    }
+  }
+}
+
+//------------------------------------//
+//            Pareto Front            //
+//------------------------------------//
+
+static int
+dominates(const result_t *a, const result_t *b)
+{
+  return a->rate <= b->rate && a->storage <= b->storage && a->ns <= b->ns &&
+         (a->rate < b->rate || a->storage < b->storage || a->ns < b->ns);
+}
+
+static int
+on_front(const result_t *r)
+{
+  if (!r->feasible) {
+    return 0;
+  }
+  for (int i = 0; i < nresults; i++) {
+    if (results[i].feasible && dominates(&results[i], r)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int
+by_storage(const void *a, const void *b)
+{
+  const result_t *x = a, *y = b;
+  return (x->storage > y->storage) - (x->storage < y->storage);
+}
+
+//------------------------------------//
+//               Driver               //
+//------------------------------------//
+
+void
+usage()
+{
+  fprintf(stderr,"Usage: tune <options> <trace> [<trace> ...]\n");
+  fprintf(stderr," Options:\n");
+  fprintf(stderr," --budget=<bits>      Storage limit (default 65792)\n");
+  fprintf(stderr," --jobs=<n>           Parallel workers (default: one per CPU)\n");
+  fprintf(stderr," --sample=<n>         Branches used per trace (default 1M)\n");
+  fprintf(stderr," --generations=<n>    Search rounds (default 8)\n");
+  fprintf(stderr," --cache-file=<path>  Result cache (default tune.cache)\n");
+}
+
+// Queue a candidate unless it was seen before or is over budget
+//
+static void
+propose(result_t *batch, int *n, config_t c)
+{
+  if (!uses_local(c.type)) {
+    c.l = c.p = 0;
+  }
+  if (*n >= MAX_CANDIDATES / 8 || nresults + *n >= MAX_CANDIDATES ||
+      find_result(&c) != NULL) {
+    return;
+  }
+  for (int i = 0; i < *n; i++) {
+    if (!memcmp(&batch[i].config, &c, sizeof(c))) {
+      return;
+    }
+  }
+  result_t r;
+  memset(&r, 0, sizeof(r));
+  r.config = c;
+  r.storage = config_storage(&c);
+  r.feasible = r.storage <= budget;
+  if (!r.feasible) {
+    // Remember it so it is never proposed again
+    results[nresults++] = r;
+    return;
+  }
+  batch[(*n)++] = r;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *paths[MAX_TRACES];
+  uint64_t sig = 14695981039346656037ULL;
+
+  jobs = clamp(sysconf(_SC_NPROCESSORS_ONLN), 1, MAX_JOBS);
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i],"--budget=",9)) {
+      budget = strtoul(argv[i]+9, NULL, 10);
+    } else if (!strncmp(argv[i],"--jobs=",7)) {
+      jobs = clamp(atoi(argv[i]+7), 1, MAX_JOBS);
+    } else if (!strncmp(argv[i],"--sample=",9)) {
+      sample = strtoull(argv[i]+9, NULL, 10);
+    } else if (!strncmp(argv[i],"--generations=",14)) {
+      generations = atoi(argv[i]+14);
+    } else if (!strncmp(argv[i],"--cache-file=",13)) {
+      cacheFile = argv[i]+13;
+    } else if (!strncmp(argv[i],"--",2)) {
+      usage();
+      exit(strcmp(argv[i],"--help") != 0);
+    } else if (ntraces < MAX_TRACES) {
+      paths[ntraces++] = argv[i];
+    }
+  }
+  if (ntraces == 0) {
+    usage();
+    exit(1);
+  }
+
+  // Bring every trace into memory once, through the shared cache
+  // when possible, and keep only the packed sample for the workers
+  struct stat st;
+  const char *cacheDir = (stat("/dev/shm", &st) == 0) ? "/dev/shm" : "/tmp";
+  for (int t = 0; t < ntraces; t++) {
+    trace_t trace;
+    if (!trace_attach_cached(paths[t], cacheDir, &trace)) {
+      pid_t decoder;
+      FILE *stream = trace_open_stream(paths[t], &decoder);
+      if (stream == NULL || !trace_read_all(stream, &trace)) {
+        fprintf(stderr,"Cannot read trace %s\n", paths[t]);
+        exit(1);
+      }
+      trace_close_stream(stream, decoder);
+    }
+    uint64_t n = trace.count < sample ? trace.count : sample;
+    for (uint64_t i = 0; i < n; i++) {
+      sig = (sig ^ trace.pc[i] ^ trace.outcome[i]) * 1099511628211ULL;
+    }
+    if (!trace_pack(&trace, n, &traces[t])) {
+      fprintf(stderr,"Cannot pack trace %s\n", paths[t]);
+      exit(1);
+    }
+    trace_detach(&trace);
+  }
+  signature = sig;
+  srand(1);
+  load_cache();
+
+  result_t batch[MAX_CANDIDATES / 8];
+  for (int gen = 0; gen <= generations; gen++) {
+    int n = 0;
+
+    // Seed with random points, then climb from the current front
+    for (int i = 0; i < (gen == 0 ? 4 * NSCHEMES : 4); i++) {
+      propose(batch, &n, random_config());
+    }
+    int before = nresults;
+    for (int i = 0; i < before; i++) {
+      if (on_front(&results[i])) {
+        for (int k = 0; k < 3; k++) {
+          propose(batch, &n, mutate(results[i].config));
+        }
+      }
+    }
+
+    evaluate_parallel(batch, n);
+    for (int i = 0; i < n; i++) {
+      results[nresults++] = batch[i];
+      append_cache(&batch[i]);
+    }
+    fprintf(stderr,"Generation %d: %d evaluated, %d known\n", gen, n, nresults);
+  }
+
+  // Print the Pareto front
+  result_t front[MAX_CANDIDATES];
+  int nfront = 0;
+  for (int i = 0; i < nresults; i++) {
+    if (on_front(&results[i])) {
+      front[nfront++] = results[i];
+    }
+  }
+  qsort(front, nfront, sizeof(result_t), by_storage);
+
+  printf("%-24s %10s %10s %10s\n", "Configuration", "Storage", "Mispred %",
+         "ns/branch");
+  for (int i = 0; i < nfront; i++) {
+    char name[64];
+    config_name(&front[i].config, name, sizeof(name));
+    printf("%-24s %10u %10.3f %10.2f\n", name, front[i].storage,
+           front[i].rate, front[i].ns);
+  }
+
+  for (int t = 0; t < ntraces; t++) {
+    trace_free_packed(&traces[t]);
+  }
+  return 0;
+}
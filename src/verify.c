@@ -0,0 +1,173 @@
+//========================================================//
+//  verify.c                                              //
+//  Differential check of two predictor builds            //
+//                                                        //
+//  Runs a reference and a candidate predictor command    //
+//  over the same trace with --verbose and compares their //
+//  predictions branch by branch, reporting the first     //
+//  branch on which they disagree                         //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+#define CONTEXT 8   // Branches shown before a divergence
+
+void
+usage()
+{
+  fprintf(stderr,"Usage: verify <trace> \"<reference command>\" "
+                 "\"<candidate command>\"\n");
+  fprintf(stderr," Each command is run through the shell with --verbose added\n"
+                 " and the decoded trace on its standard input, e.g.\n"
+                 "   verify ../traces/int_1.bz2 \"gshare/predictor --gshare:13\" "
+                 "\"./predictor --gshare:13\"\n");
+}
+
+// Start 'command' reading the trace at 'path' on its standard input
+//
+FILE *
+start(const char *path, const char *command)
+{
+  // Quote the path for the shell; a ' becomes '\''
+  char *quoted = malloc(4 * strlen(path) + 3);
+  char *q = quoted;
+  *q++ = '\'';
+  for (const char *p = path; *p; p++) {
+    if (*p == '\'') {
+      memcpy(q, "'\\''", 4);
+      q += 4;
+    } else {
+      *q++ = *p;
+    }
+  }
+  *q++ = '\'';
+  *q = '\0';
+
+  size_t n = strlen(quoted) + strlen(command) + 64;
+  char *line = malloc(n);
+  int bz2 = strlen(path) > 4 && !strcmp(path + strlen(path) - 4, ".bz2");
+  snprintf(line, n, "%s %s | %s --verbose", bz2 ? "bunzip2 -kc" : "cat",
+           quoted, command);
+  FILE *f = popen(line, "r");
+  free(line);
+  free(quoted);
+  return f;
+}
+
+// Read the next prediction printed by a predictor.  The report that
+// follows the predictions ends the stream
+//
+// Returns 0 or 1, or -1 at the end of the predictions
+//
+int
+next_prediction(FILE *f, char **buf, size_t *len)
+{
+  if (getline(buf, len, f) == -1) {
+    return -1;
+  }
+  if (((*buf)[0] == '0' || (*buf)[0] == '1') && (*buf)[1] == '\n') {
+    return (*buf)[0] - '0';
+  }
+  return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (argc != 4) {
+    usage();
+    exit(1);
+  }
+  const char *path = argv[1];
+
+  // The decoded trace, to show the branches around a divergence
+  trace_t trace;
+  struct stat st;
+  const char *cacheDir = (stat("/dev/shm", &st) == 0) ? "/dev/shm" : "/tmp";
+  if (!trace_attach_cached(path, cacheDir, &trace)) {
+    pid_t decoder;
+    FILE *stream = trace_open_stream(path, &decoder);
+    if (stream == NULL || !trace_read_all(stream, &trace)) {
+      fprintf(stderr,"Cannot read trace %s\n", path);
+      exit(1);
+    }
+    trace_close_stream(stream, decoder);
+  }
+
+  FILE *ref = start(path, argv[2]);
+  FILE *cand = start(path, argv[3]);
+  if (ref == NULL || cand == NULL) {
+    perror("popen");
+    exit(1);
+  }
+
+  char *refBuf = NULL, *candBuf = NULL;
+  size_t refLen = 0, candLen = 0;
+  uint8_t refHist[CONTEXT], candHist[CONTEXT];
+  uint64_t i;
+  int diverged = 0;
+
+  // Compare in lockstep, one branch at a time
+  for (i = 0; ; i++) {
+    int r = next_prediction(ref, &refBuf, &refLen);
+    int c = next_prediction(cand, &candBuf, &candLen);
+    if (r < 0 && c < 0) {
+      break;
+    }
+    if (r != c) {
+      diverged = 1;
+      break;
+    }
+    refHist[i % CONTEXT] = r;
+    candHist[i % CONTEXT] = c;
+  }
+
+  int status = 0;
+  if (!diverged) {
+    if (i != trace.count) {
+      printf("Both predicted %llu of %llu branches\n",
+             (unsigned long long)i, (unsigned long long)trace.count);
+      status = 1;
+    } else {
+      printf("Identical predictions over %llu branches\n",
+             (unsigned long long)i);
+    }
+  } else {
+    int r = (refBuf && (refBuf[0] == '0' || refBuf[0] == '1')) ?
+            refBuf[0] - '0' : -1;
+    int c = (candBuf && (candBuf[0] == '0' || candBuf[0] == '1')) ?
+            candBuf[0] - '0' : -1;
+    printf("First divergence at branch %llu\n", (unsigned long long)i);
+    printf("  %10s  %10s  %7s  %9s  %9s\n", "Branch", "PC", "Outcome",
+           "Reference", "Candidate");
+    uint64_t first = i >= CONTEXT ? i - CONTEXT : 0;
+    for (uint64_t k = first; k <= i && k < trace.count; k++) {
+      int kr = k == i ? r : refHist[k % CONTEXT];
+      int kc = k == i ? c : candHist[k % CONTEXT];
+      printf("%c %10llu  0x%08x  %7d  %9s  %9s\n", k == i ? '>' : ' ',
+             (unsigned long long)k, trace.pc[k], trace.outcome[k],
+             kr < 0 ? "(end)" : kr ? "taken" : "not taken",
+             kc < 0 ? "(end)" : kc ? "taken" : "not taken");
+    }
+    status = 1;
+  }
+
+  // Drain so the commands are not killed by a closed pipe
+  while (getline(&refBuf, &refLen, ref) != -1);
+  while (getline(&candBuf, &candLen, cand) != -1);
+  int refStatus = pclose(ref);
+  int candStatus = pclose(cand);
+  if (refStatus != 0 || candStatus != 0) {
+    fprintf(stderr,"A predictor command failed\n");
+    status = 1;
+  }
+  free(refBuf);
+  free(candBuf);
+  trace_detach(&trace);
+  return status;
+}